@@ -0,0 +1,59 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Keeps the optimizer from discarding a benchmarked result.
+template<typename T>
+inline void benchKeep(const T &value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+// Runs fn(i) for i in [0, iterations) and reports nanoseconds per call.
+template<typename Fn>
+double benchNsPerOp(const std::size_t iterations, Fn &&fn) {
+    for (std::size_t i = 0; i < iterations / 16; ++i) fn(i);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < iterations; ++i) fn(i);
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / static_cast<double>(iterations);
+}
+
+// Set by benchParseArgs() from --json: benchReport() then prints one JSON
+// object per line, for scripts that compare runs.
+inline bool benchJsonOutput = false;
+
+inline void benchParseArgs(const int argc, char **argv) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::string_view(argv[i]) == "--json") benchJsonOutput = true;
+    }
+}
+
+// bytesPerOp, when given, adds the throughput the call moved.
+inline void benchReport(const char *suite, const std::string &name, const double nsPerOp,
+                        const double bytesPerOp = 0) {
+    const double mbPerSecond = bytesPerOp > 0 && nsPerOp > 0 ? bytesPerOp / nsPerOp * 1e3 : 0;
+    if (benchJsonOutput) {
+        printf("{\"suite\":\"%s\",\"name\":\"%s\",\"ns_per_op\":%.2f,\"bytes_per_op\":%.0f,\"mb_per_s\":%.1f}\n",
+               suite, name.c_str(), nsPerOp, bytesPerOp, mbPerSecond);
+    } else if (bytesPerOp > 0) {
+        printf("%s/%-40s %10.2f ns/op %10.1f MB/s\n", suite, name.c_str(), nsPerOp, mbPerSecond);
+    } else {
+        printf("%s/%-40s %10.2f ns/op\n", suite, name.c_str(), nsPerOp);
+    }
+}
+
+// Class names shaped like the ones a busy application server loads.
+inline std::vector<std::string> benchClassNames(const char *prefix, const std::size_t count) {
+    std::vector<std::string> names;
+    names.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        names.push_back(std::string(prefix) + "/module" + std::to_string(i % 97) + "/Class" + std::to_string(i));
+    }
+    return names;
+}
@@ -0,0 +1,284 @@
+#pragma once
+
+#include <jni.h>
+#include <jvmti.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// In-process stand-in for the parts of a JVM the library calls, so the code
+// in org_example_Native.cpp can be driven without one. Function tables are
+// filled by member name; functions the benchmarks never reach stay null, so
+// a new call shows up as a crash here rather than as a silently wrong
+// answer.
+//
+// Objects live as long as the FakeJvm and every reference, local, global or
+// weak, is the object's address, so IsSameObject is a pointer compare. Class
+// file load hook delivery follows HotSpot: a retransform runs the hook on the
+// retransforming thread when it is enabled globally or for that thread, and
+// installs what the hook returns. Not thread-safe; one FakeJvm per process.
+
+struct FakeObject {
+    enum class Kind { Class, Loader, String, ByteArray, ObjectArray, LongArray, Thread };
+
+    Kind kind;
+    // Class internal name or string contents.
+    std::string text;
+    jobject loader = nullptr;
+    jint identityHash = 0;
+    // Byte array contents, or the class's current class file.
+    std::vector<unsigned char> bytes;
+    std::vector<jobject> elements;
+    std::vector<jlong> longs;
+};
+
+class FakeJvm {
+public:
+    FakeJvm() {
+        instance_ = this;
+        thread_ = handle(make(FakeObject::Kind::Thread));
+        fillJni();
+        fillJvmti();
+        invoke_.GetEnv = [](JavaVM *, void **env, const jint version) -> jint {
+            // JVMTI versions carry 0x30000000; anything else asks for JNI.
+            *env = (version & 0x30000000) == 0x30000000
+                       ? static_cast<void *>(&current().jvmtiEnv_)
+                       : static_cast<void *>(&current().env_);
+            return JNI_OK;
+        };
+    }
+
+    ~FakeJvm() { instance_ = nullptr; }
+
+    FakeJvm(const FakeJvm &) = delete;
+    FakeJvm &operator=(const FakeJvm &) = delete;
+
+    JavaVM *vm() { return &vm_; }
+    JNIEnv *env() { return &env_; }
+    jvmtiEnv *jvmti() { return &jvmtiEnv_; }
+
+    // The callback the library installed with SetEventCallbacks.
+    jvmtiEventClassFileLoadHook classFileLoadHook() const { return callbacks_.ClassFileLoadHook; }
+
+    jobject newLoader() { return handle(make(FakeObject::Kind::Loader)); }
+
+    jclass defineClass(const std::string_view internalName, jobject loader, std::span<const unsigned char> bytes) {
+        FakeObject &cls = make(FakeObject::Kind::Class);
+        cls.text = internalName;
+        cls.loader = loader;
+        cls.bytes.assign(bytes.begin(), bytes.end());
+        return reinterpret_cast<jclass>(&cls);
+    }
+
+    jbyteArray newByteArray(std::span<const unsigned char> bytes) {
+        FakeObject &array = make(FakeObject::Kind::ByteArray);
+        array.bytes.assign(bytes.begin(), bytes.end());
+        return reinterpret_cast<jbyteArray>(&array);
+    }
+
+    static FakeObject &object(jobject ref) { return *reinterpret_cast<FakeObject *>(ref); }
+
+    // Class file load hook events delivered and class files replaced.
+    std::size_t hookCalls = 0;
+    std::size_t hookReplacements = 0;
+
+private:
+    static FakeJvm &current() { return *instance_; }
+
+    static jobject handle(FakeObject &object) { return reinterpret_cast<jobject>(&object); }
+
+    FakeObject &make(const FakeObject::Kind kind) {
+        FakeObject &object = objects_.emplace_back();
+        object.kind = kind;
+        object.identityHash = static_cast<jint>(objects_.size() * 2654435761u);
+        return object;
+    }
+
+    // HotSpot's ClassFileLoadHook for one class being retransformed.
+    void retransformOne(jclass cls) {
+        FakeObject &klass = object(cls);
+        if (!callbacks_.ClassFileLoadHook || (globalHook_ == 0 && threadHook_ == 0)) return;
+        jint newLength = 0;
+        unsigned char *newBytes = nullptr;
+        hookCalls++;
+        callbacks_.ClassFileLoadHook(&jvmtiEnv_, &env_, cls, klass.loader, klass.text.c_str(), nullptr,
+                                     static_cast<jint>(klass.bytes.size()), klass.bytes.data(), &newLength,
+                                     &newBytes);
+        if (!newBytes) return;
+        hookReplacements++;
+        klass.bytes.assign(newBytes, newBytes + newLength);
+        std::free(newBytes);
+    }
+
+    // C variadic, so it cannot be a lambda.
+    static jvmtiError JNICALL setEventNotificationMode(jvmtiEnv *, const jvmtiEventMode mode, const jvmtiEvent event,
+                                                       jthread thread, ...) {
+        if (event != JVMTI_EVENT_CLASS_FILE_LOAD_HOOK) return JVMTI_ERROR_NONE;
+        // The only thread object is the calling thread's.
+        int &enabled = thread ? current().threadHook_ : current().globalHook_;
+        enabled = mode == JVMTI_ENABLE;
+        return JVMTI_ERROR_NONE;
+    }
+
+    void fillJni() {
+        jni_.FindClass = [](JNIEnv *, const char *name) -> jclass {
+            FakeJvm &jvm = current();
+            auto [it, added] = jvm.systemClasses_.try_emplace(name, nullptr);
+            if (added) it->second = jvm.defineClass(name, nullptr, {});
+            return it->second;
+        };
+        jni_.ExceptionCheck = [](JNIEnv *) -> jboolean { return JNI_FALSE; };
+        jni_.ExceptionClear = [](JNIEnv *) {
+        };
+        jni_.NewGlobalRef = [](JNIEnv *, jobject ref) { return ref; };
+        jni_.DeleteGlobalRef = [](JNIEnv *, jobject) {
+        };
+        jni_.NewLocalRef = [](JNIEnv *, jobject ref) { return ref; };
+        jni_.DeleteLocalRef = [](JNIEnv *, jobject) {
+        };
+        jni_.NewWeakGlobalRef = [](JNIEnv *, jobject ref) -> jweak { return ref; };
+        jni_.DeleteWeakGlobalRef = [](JNIEnv *, jweak) {
+        };
+        jni_.IsSameObject = [](JNIEnv *, jobject a, jobject b) -> jboolean { return a == b; };
+        jni_.GetStaticMethodID = [](JNIEnv *, jclass, const char *, const char *) {
+            static int method;
+            return reinterpret_cast<jmethodID>(&method);
+        };
+        jni_.RegisterNatives = [](JNIEnv *, jclass, const JNINativeMethod *, jint) -> jint { return JNI_OK; };
+        jni_.GetJavaVM = [](JNIEnv *, JavaVM **vm) -> jint {
+            *vm = current().vm();
+            return JNI_OK;
+        };
+        jni_.NewStringUTF = [](JNIEnv *, const char *chars) -> jstring {
+            FakeObject &string = current().make(FakeObject::Kind::String);
+            string.text = chars;
+            return reinterpret_cast<jstring>(&string);
+        };
+        jni_.GetStringUTFChars = [](JNIEnv *, jstring string, jboolean *isCopy) -> const char * {
+            if (isCopy) *isCopy = JNI_FALSE;
+            return object(string).text.c_str();
+        };
+        jni_.ReleaseStringUTFChars = [](JNIEnv *, jstring, const char *) {
+        };
+        jni_.GetStringUTFLength = [](JNIEnv *, jstring string) -> jsize {
+            return static_cast<jsize>(object(string).text.size());
+        };
+        jni_.GetArrayLength = [](JNIEnv *, jarray array) -> jsize {
+            const FakeObject &fake = object(array);
+            switch (fake.kind) {
+                case FakeObject::Kind::ByteArray: return static_cast<jsize>(fake.bytes.size());
+                case FakeObject::Kind::ObjectArray: return static_cast<jsize>(fake.elements.size());
+                case FakeObject::Kind::LongArray: return static_cast<jsize>(fake.longs.size());
+                default: return 0;
+            }
+        };
+        jni_.GetObjectArrayElement = [](JNIEnv *, jobjectArray array, const jsize index) {
+            return object(array).elements[index];
+        };
+        jni_.GetByteArrayElements = [](JNIEnv *, jbyteArray array, jboolean *isCopy) {
+            if (isCopy) *isCopy = JNI_FALSE;
+            return reinterpret_cast<jbyte *>(object(array).bytes.data());
+        };
+        jni_.ReleaseByteArrayElements = [](JNIEnv *, jbyteArray, jbyte *, jint) {
+        };
+        jni_.GetByteArrayRegion = [](JNIEnv *, jbyteArray array, const jsize start, const jsize length, jbyte *out) {
+            std::memcpy(out, object(array).bytes.data() + start, static_cast<std::size_t>(length));
+        };
+        jni_.NewLongArray = [](JNIEnv *, const jsize length) -> jlongArray {
+            FakeObject &array = current().make(FakeObject::Kind::LongArray);
+            array.longs.resize(length);
+            return reinterpret_cast<jlongArray>(&array);
+        };
+        jni_.SetLongArrayRegion = [](JNIEnv *, jlongArray array, const jsize start, const jsize length,
+                                     const jlong *values) {
+            std::memcpy(object(array).longs.data() + start, values, length * sizeof(jlong));
+        };
+        env_.functions = &jni_;
+        vm_.functions = &invoke_;
+    }
+
+    void fillJvmti() {
+        jvmti_.GetVersionNumber = [](jvmtiEnv *, jint *version) {
+            *version = 0x30150000;
+            return JVMTI_ERROR_NONE;
+        };
+        jvmti_.GetPotentialCapabilities = [](jvmtiEnv *, jvmtiCapabilities *capabilities) {
+            std::memset(capabilities, 0xFF, sizeof(*capabilities));
+            return JVMTI_ERROR_NONE;
+        };
+        jvmti_.AddCapabilities = [](jvmtiEnv *, const jvmtiCapabilities *) { return JVMTI_ERROR_NONE; };
+        jvmti_.SetEventCallbacks = [](jvmtiEnv *, const jvmtiEventCallbacks *callbacks, const jint size) {
+            current().callbacks_ = {};
+            if (!callbacks) return JVMTI_ERROR_NONE;
+            std::memcpy(&current().callbacks_, callbacks,
+                        std::min(static_cast<std::size_t>(size), sizeof(jvmtiEventCallbacks)));
+            return JVMTI_ERROR_NONE;
+        };
+        jvmti_.SetEventNotificationMode = setEventNotificationMode;
+        jvmti_.GetCurrentThread = [](jvmtiEnv *, jthread *thread) {
+            *thread = current().thread_;
+            return JVMTI_ERROR_NONE;
+        };
+        jvmti_.Allocate = [](jvmtiEnv *, const jlong size, unsigned char **memory) {
+            *memory = static_cast<unsigned char *>(std::malloc(size > 0 ? static_cast<std::size_t>(size) : 1));
+            return *memory ? JVMTI_ERROR_NONE : JVMTI_ERROR_OUT_OF_MEMORY;
+        };
+        jvmti_.Deallocate = [](jvmtiEnv *, unsigned char *memory) {
+            std::free(memory);
+            return JVMTI_ERROR_NONE;
+        };
+        jvmti_.GetClassSignature = [](jvmtiEnv *env, jclass cls, char **signature, char **generic) {
+            const std::string &name = object(cls).text;
+            unsigned char *out = nullptr;
+            if (const jvmtiError err = env->Allocate(static_cast<jlong>(name.size() + 3), &out);
+                err != JVMTI_ERROR_NONE) {
+                return err;
+            }
+            out[0] = 'L';
+            std::memcpy(out + 1, name.data(), name.size());
+            out[name.size() + 1] = ';';
+            out[name.size() + 2] = '\0';
+            *signature = reinterpret_cast<char *>(out);
+            if (generic) *generic = nullptr;
+            return JVMTI_ERROR_NONE;
+        };
+        jvmti_.GetClassLoader = [](jvmtiEnv *, jclass cls, jobject *loader) {
+            *loader = object(cls).loader;
+            return JVMTI_ERROR_NONE;
+        };
+        jvmti_.GetObjectHashCode = [](jvmtiEnv *, jobject ref, jint *hash) {
+            *hash = object(ref).identityHash;
+            return JVMTI_ERROR_NONE;
+        };
+        jvmti_.IsModifiableClass = [](jvmtiEnv *, jclass, jboolean *modifiable) {
+            *modifiable = JNI_TRUE;
+            return JVMTI_ERROR_NONE;
+        };
+        jvmti_.RetransformClasses = [](jvmtiEnv *, const jint count, const jclass *classes) {
+            for (jint i = 0; i < count; ++i) current().retransformOne(classes[i]);
+            return JVMTI_ERROR_NONE;
+        };
+        jvmtiEnv_.functions = &jvmti_;
+    }
+
+    JNINativeInterface_ jni_{};
+    JNIInvokeInterface_ invoke_{};
+    jvmtiInterface_1_ jvmti_{};
+    JNIEnv env_{};
+    JavaVM vm_{};
+    ::jvmtiEnv jvmtiEnv_{};
+    jvmtiEventCallbacks callbacks_{};
+    jobject thread_ = nullptr;
+    int globalHook_ = 0;
+    int threadHook_ = 0;
+    std::deque<FakeObject> objects_;
+    std::unordered_map<std::string, jclass> systemClasses_;
+    inline static FakeJvm *instance_ = nullptr;
+};
@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+#include "class_names.h"
+#include "fake_jvm.h"
+#include "org_example_Native.h"
+
+// Drives the hot paths of org_example_Native.cpp through FakeJvm, with no JVM:
+// the class file load hook on hits and misses, staging and committing 1k to
+// 100k classes, class name conversion and the copies each call makes. Run
+// with --json for one JSON object per result, to diff against a baseline.
+
+static constexpr std::size_t iterations = 1'000'000;
+static constexpr std::size_t sampleCount = 4096;
+static constexpr std::size_t sampleMask = sampleCount - 1;
+
+static std::vector<unsigned char> classFile(const std::size_t size, const unsigned char seed) {
+    std::vector<unsigned char> bytes(size);
+    for (std::size_t i = 0; i < size; ++i) bytes[i] = static_cast<unsigned char>(i * 31 + seed);
+    std::copy_n("\xCA\xFE\xBA\xBE", std::min<std::size_t>(size, 4), bytes.begin());
+    return bytes;
+}
+
+// About a gigabyte per copy benchmark, whatever the class size.
+static std::size_t copyIterations(const std::size_t size) {
+    return std::max<std::size_t>(2000, (std::size_t{1} << 30) / size);
+}
+
+static std::string sizeLabel(const std::size_t size) {
+    return size >= 1024 ? std::to_string(size / 1024) + "k" : std::to_string(size) + "b";
+}
+
+static void fail(const char *what) {
+    fprintf(stderr, "hook_path: %s\n", what);
+    std::exit(1);
+}
+
+static double elapsedNanos(const std::chrono::steady_clock::time_point from) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - from).count();
+}
+
+struct StagedSet {
+    std::vector<jclass> classes;
+    std::vector<jbyteArray> arrays;
+};
+
+static StagedSet defineClasses(FakeJvm &jvm, jobject loader, const std::string &prefix, const std::size_t count,
+                               const std::size_t size) {
+    StagedSet set;
+    const auto original = classFile(size, 0);
+    const auto patched = classFile(size, 1);
+    for (const auto &name: benchClassNames(prefix.c_str(), count)) {
+        set.classes.push_back(jvm.defineClass(name, loader, original));
+        set.arrays.push_back(jvm.newByteArray(patched));
+    }
+    return set;
+}
+
+static void stageAll(JNIEnv *env, const StagedSet &set, const jint lifecycle) {
+    for (std::size_t i = 0; i < set.classes.size(); ++i) {
+        Java_org_example_Native_stageClassWithMode(env, nullptr, set.classes[i], set.arrays[i], lifecycle);
+    }
+}
+
+static void commit(JNIEnv *env) {
+    if (Java_org_example_Native_commitStaged(env, nullptr) != JVMTI_ERROR_NONE) fail("commitStaged failed");
+}
+
+// Staging then committing count classes: the staging set, the sealed batch
+// snapshot and one hook hit per class as the fake VM retransforms them.
+static void benchStaging(FakeJvm &jvm, jobject loader, const std::size_t count) {
+    JNIEnv *env = jvm.env();
+    const std::string label = std::to_string(count);
+    const StagedSet set = defineClasses(jvm, loader, "com/example/staging" + label, count, 512);
+
+    auto start = std::chrono::steady_clock::now();
+    stageAll(env, set, org_example_Native_LIFECYCLE_ONE_SHOT);
+    benchReport("hook_path", "stage/" + label, elapsedNanos(start) / static_cast<double>(count));
+
+    const std::size_t replaced = jvm.hookReplacements;
+    start = std::chrono::steady_clock::now();
+    commit(env);
+    benchReport("hook_path", "commit/" + label, elapsedNanos(start) / static_cast<double>(count));
+    if (jvm.hookReplacements - replaced != count) fail("commit did not replace every staged class");
+
+    for (jclass cls: set.classes) Java_org_example_Native_unstageClass(env, nullptr, cls);
+    commit(env);
+}
+
+// One load or retransform through the hook; the VM frees what it returns.
+static std::size_t callHook(FakeJvm &jvm, jclass redefined, jobject loader, const char *name) {
+    static const auto original = classFile(256, 0);
+    jint length = 0;
+    unsigned char *replaced = nullptr;
+    jvm.classFileLoadHook()(jvm.jvmti(), jvm.env(), redefined, loader, name, nullptr,
+                            static_cast<jint>(original.size()), original.data(), &length, &replaced);
+    if (!replaced) return 0;
+    jvm.jvmti()->Deallocate(replaced);
+    return static_cast<std::size_t>(length);
+}
+
+static void benchHook(FakeJvm &jvm, jobject loader) {
+    JNIEnv *env = jvm.env();
+    // Sticky classes stay matched after their commit, the way a retransform
+    // by another agent meets them again.
+    const StagedSet fillers = defineClasses(jvm, loader, "com/example/sticky", 10000, 256);
+    stageAll(env, fillers, org_example_Native_LIFECYCLE_STICKY);
+    const std::size_t sizes[] = {1024, 16 * 1024, 256 * 1024};
+    std::vector<StagedSet> sized;
+    for (const std::size_t size: sizes) {
+        sized.push_back(defineClasses(jvm, loader, "com/example/sized" + sizeLabel(size), 1, size));
+        stageAll(env, sized.back(), org_example_Native_LIFECYCLE_STICKY);
+    }
+    commit(env);
+
+    std::vector<std::string> fillerNames, loadedNames;
+    std::vector<jclass> fillerClasses, unstagedClasses;
+    const auto loaded = benchClassNames("org/springframework/context/support", sampleCount);
+    for (std::size_t i = 0; i < sampleCount; ++i) {
+        const std::size_t filler = i * 7919 % fillers.classes.size();
+        fillerClasses.push_back(fillers.classes[filler]);
+        fillerNames.emplace_back(FakeJvm::object(fillers.classes[filler]).text);
+        unstagedClasses.push_back(jvm.defineClass(loaded[i], loader, {}));
+        loadedNames.push_back(loaded[i]);
+    }
+    if (callHook(jvm, fillerClasses[0], loader, fillerNames[0].c_str()) != 256) fail("sticky class not matched");
+
+    benchReport("hook_path", "hook_miss_load", benchNsPerOp(iterations, [&](const std::size_t i) {
+        benchKeep(callHook(jvm, nullptr, loader, loadedNames[i & sampleMask].c_str()));
+    }));
+    benchReport("hook_path", "hook_miss_retransform", benchNsPerOp(iterations, [&](const std::size_t i) {
+        benchKeep(callHook(jvm, unstagedClasses[i & sampleMask], loader, loadedNames[i & sampleMask].c_str()));
+    }));
+    benchReport("hook_path", "hook_hit/256b", benchNsPerOp(iterations, [&](const std::size_t i) {
+        benchKeep(callHook(jvm, fillerClasses[i & sampleMask], loader, fillerNames[i & sampleMask].c_str()));
+    }), 256);
+    for (std::size_t s = 0; s < std::size(sizes); ++s) {
+        jclass cls = sized[s].classes[0];
+        const std::string name = FakeJvm::object(cls).text;
+        benchReport("hook_path", "hook_hit/" + sizeLabel(sizes[s]),
+                    benchNsPerOp(copyIterations(sizes[s]), [&](std::size_t) {
+                        benchKeep(callHook(jvm, cls, loader, name.c_str()));
+                    }), static_cast<double>(sizes[s]));
+    }
+}
+
+static void benchNames(FakeJvm &jvm, jobject loader) {
+    const auto names = benchClassNames("io/netty/channel/socket", sampleCount);
+    std::vector<std::string> descriptors;
+    std::vector<jclass> classes;
+    for (const auto &name: names) {
+        descriptors.push_back("L" + name + ";");
+        classes.push_back(jvm.defineClass(name, loader, {}));
+        internName(name);
+    }
+
+    benchReport("hook_path", "names/descriptor_to_internal", benchNsPerOp(iterations, [&](const std::size_t i) {
+        benchKeep(descriptorToInternalName(descriptors[i & sampleMask]));
+    }));
+    benchReport("hook_path", "names/intern_existing", benchNsPerOp(iterations, [&](const std::size_t i) {
+        benchKeep(internName(names[i & sampleMask]));
+    }));
+    benchReport("hook_path", "names/internal_class_name", benchNsPerOp(iterations, [&](const std::size_t i) {
+        benchKeep(internalClassName(jvm.jvmti(), classes[i & sampleMask]));
+    }));
+}
+
+// Restaging a class copies its bytes out of the Java array and hashes them.
+static void benchCopies(FakeJvm &jvm, jobject loader) {
+    for (const std::size_t size: {std::size_t{1024}, std::size_t{16 * 1024}, std::size_t{256 * 1024}}) {
+        const StagedSet set = defineClasses(jvm, loader, "com/example/copy" + sizeLabel(size), 1, size);
+        benchReport("hook_path", "copy/stage_class/" + sizeLabel(size),
+                    benchNsPerOp(copyIterations(size), [&](std::size_t) {
+                        Java_org_example_Native_stageClass(jvm.env(), nullptr, set.classes[0], set.arrays[0]);
+                    }), static_cast<double>(size));
+        Java_org_example_Native_unstageClass(jvm.env(), nullptr, set.classes[0]);
+    }
+}
+
+int main(const int argc, char **argv) {
+    benchParseArgs(argc, argv);
+    // Info messages would interleave with the results on stdout.
+    Java_org_example_Native_setLogLevel(nullptr, nullptr, org_example_Native_LOG_ERROR);
+
+    FakeJvm jvm;
+    if (JNI_OnLoad(jvm.vm(), nullptr) == JNI_ERR) fail("JNI_OnLoad failed");
+    const jobject loader = jvm.newLoader();
+
+    for (const std::size_t count: {1000, 10000, 100000}) {
+        benchStaging(jvm, loader, count);
+    }
+    benchHook(jvm, loader);
+    benchNames(jvm, loader);
+    benchCopies(jvm, loader);
+
+    JNI_OnUnload(jvm.vm(), nullptr);
+    return 0;
+}
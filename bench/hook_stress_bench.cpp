@@ -0,0 +1,164 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "bench_util.h"
+#include "staging.h"
+
+// Many threads load classes while another keeps retransforming batches, the
+// way a server running thousands of virtual threads hits the hook while an
+// agent patches classes. Loader threads outnumber cores, as carrier threads
+// do once virtual threads pin them, so a loader that blocks holds up others.
+// Reports the per-call latency distribution of the hook path and the time
+// taken by each retransform publish, for the snapshot channels and for the
+// old mutex-guarded map.
+
+static constexpr std::size_t callsPerLoader = 200'000;
+static constexpr std::size_t batchSize = 1000;
+
+using Clock = std::chrono::steady_clock;
+
+struct Samples {
+    std::vector<std::int64_t> nanos;
+
+    void add(const Clock::time_point from, const Clock::time_point to) {
+        nanos.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count());
+    }
+
+    void report(const std::string &name) {
+        if (nanos.empty()) return;
+        std::ranges::sort(nanos);
+        const auto at = [&](const double q) { return nanos[static_cast<std::size_t>(q * (nanos.size() - 1))]; };
+        printf("hook_stress/%-44s n=%-9zu p50=%-8lld p99=%-8lld p99.9=%-9lld max=%lld ns\n", name.c_str(),
+               nanos.size(), static_cast<long long>(at(0.5)), static_cast<long long>(at(0.99)),
+               static_cast<long long>(at(0.999)), static_cast<long long>(nanos.back()));
+    }
+};
+
+// The hook path without JNI: every class is defined by the bootstrap loader,
+// so matching never calls back into the VM.
+static bool snapshotHook(const char *name, const bool redefined) {
+    StagingKey key;
+    const bool batchMayMatch = stagingMayContain(name, key);
+    const bool stickyMayMatch = redefined && stagingMayContain(name, key, StagingChannel::Sticky);
+    if (!batchMayMatch && !stickyMayMatch) return false;
+
+    const StagingReadGuard guard;
+    const StagedEntry *staged = nullptr;
+    if (const StagingSnapshot *batch = guard.snapshot(); batchMayMatch && batch) {
+        staged = batch->match(nullptr, key, nullptr);
+        if (staged) batch->recordHit(*staged);
+    }
+    if (const StagingSnapshot *sticky = guard.snapshot(StagingChannel::Sticky); !staged && stickyMayMatch && sticky) {
+        staged = sticky->match(nullptr, key, nullptr);
+        if (staged) sticky->recordHit(*staged);
+    }
+    if (!staged) return false;
+
+    const auto data = staged->bytes();
+    auto *copy = static_cast<unsigned char *>(malloc(data.size()));
+    memcpy(copy, data.data(), data.size());
+    benchKeep(copy);
+    free(copy);
+    return true;
+}
+
+static std::mutex legacyMutex;
+static std::unordered_map<std::string, std::vector<unsigned char> > legacyMap;
+
+static bool legacyHook(const char *name, bool) {
+    std::lock_guard lock(legacyMutex);
+    const auto it = legacyMap.find(name);
+    if (it == legacyMap.end()) return false;
+    auto *copy = static_cast<unsigned char *>(malloc(it->second.size()));
+    memcpy(copy, it->second.data(), it->second.size());
+    benchKeep(copy);
+    free(copy);
+    return true;
+}
+
+static void snapshotRetransform(const std::vector<std::string> &names, const std::size_t first) {
+    auto next = std::make_unique<StagingSnapshot>(batchSize * 64);
+    next->reserve(batchSize);
+    for (std::size_t i = 0; i < batchSize; ++i) {
+        next->stage(names[(first + i) % names.size()], next->allocateBytes(512));
+    }
+    publishStagingSnapshot(std::move(next));
+    publishStagingSnapshot(nullptr);
+}
+
+static void legacyRetransform(const std::vector<std::string> &names, const std::size_t first) {
+    {
+        std::lock_guard lock(legacyMutex);
+        for (std::size_t i = 0; i < batchSize; ++i) {
+            legacyMap[names[(first + i) % names.size()]] = std::vector<unsigned char>(512);
+        }
+    }
+    std::lock_guard lock(legacyMutex);
+    legacyMap.clear();
+}
+
+template<typename Hook, typename Retransform>
+static void run(const char *variant, const std::size_t loaders, const std::vector<std::string> &names,
+                Hook &&hook, Retransform &&retransform) {
+    std::atomic<std::size_t> running{loaders};
+    std::vector<Samples> loaderSamples(loaders);
+    Samples publishSamples;
+
+    std::thread writer([&] {
+        for (std::size_t round = 0; running.load(std::memory_order_relaxed) != 0; ++round) {
+            const auto start = Clock::now();
+            retransform(names, round * 7919);
+            publishSamples.add(start, Clock::now());
+        }
+    });
+
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < loaders; ++t) {
+        threads.emplace_back([&, t] {
+            Samples &samples = loaderSamples[t];
+            samples.nanos.reserve(callsPerLoader);
+            std::size_t hits = 0;
+            for (std::size_t i = 0; i < callsPerLoader; ++i) {
+                const std::string &name = names[(t * 104729 + i * 31) % names.size()];
+                const auto start = Clock::now();
+                hits += hook(name.c_str(), (i & 3) == 0);
+                samples.add(start, Clock::now());
+            }
+            benchKeep(hits);
+            running.fetch_sub(1, std::memory_order_relaxed);
+        });
+    }
+    for (auto &thread: threads) thread.join();
+    writer.join();
+
+    Samples all;
+    for (auto &samples: loaderSamples) all.nanos.insert(all.nanos.end(), samples.nanos.begin(), samples.nanos.end());
+    const std::string label = std::string(variant) + "/" + std::to_string(loaders) + "_loaders";
+    all.report(label + "/hook");
+    publishSamples.report(label + "/retransform");
+}
+
+int main(const int argc, char **argv) {
+    benchParseArgs(argc, argv);
+    const auto names = benchClassNames("com/example/service", 20000);
+
+    // A few classes stay patched on the sticky channel throughout.
+    auto sticky = std::make_unique<StagingSnapshot>();
+    for (std::size_t i = 0; i < 100; ++i) sticky->stage(names[i * 197], sticky->allocateBytes(512));
+    publishStagingSnapshot(std::move(sticky), StagingChannel::Sticky);
+
+    const std::size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    for (const std::size_t loaders: {cores, cores * 4}) {
+        run("legacy_mutex_map", loaders, names, legacyHook, legacyRetransform);
+        run("snapshot_channels", loaders, names, snapshotHook, snapshotRetransform);
+    }
+    publishStagingSnapshot(nullptr, StagingChannel::Sticky);
+    return 0;
+}
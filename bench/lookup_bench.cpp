@@ -0,0 +1,104 @@
+#include <chrono>
+#include <cstdio>
+#include <memory_resource>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "bench_util.h"
+#include "staging.h"
+
+// Compares the sealed snapshot's perfect hash with the arena-backed
+// unordered_map it replaced, for hits, misses, build time and memory. Both
+// lookups start from the bare name and hash it inside the timed loop, as the
+// hook does for each class it sees.
+
+static constexpr std::size_t iterations = 4'000'000;
+
+// Counts what a table asks its resource for, on top of an arena.
+class CountingResource : public std::pmr::memory_resource {
+public:
+    std::size_t bytes = 0;
+
+private:
+    void *do_allocate(const std::size_t size, const std::size_t align) override {
+        bytes += size;
+        return arena_.allocate(size, align);
+    }
+
+    void do_deallocate(void *, std::size_t, std::size_t) override {
+    }
+
+    bool do_is_equal(const memory_resource &other) const noexcept override { return this == &other; }
+
+    std::pmr::monotonic_buffer_resource arena_;
+};
+
+struct NameHash {
+    using is_transparent = void;
+
+    std::size_t operator()(const std::string_view name) const noexcept {
+        return std::hash<std::string_view>{}(name);
+    }
+};
+
+using MapTable = std::pmr::unordered_map<std::string_view, std::span<const unsigned char>, NameHash, std::equal_to<> >;
+
+static double elapsedMicros(const std::chrono::steady_clock::time_point from) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - from).count();
+}
+
+static void run(const std::size_t count) {
+    const auto staged = benchClassNames("com/example/patch", count);
+    const auto loaded = benchClassNames("org/springframework/context/support", 4096);
+    static const unsigned char bytes[16]{};
+    const std::string label = std::to_string(count);
+
+    auto start = std::chrono::steady_clock::now();
+    CountingResource mapMemory;
+    MapTable map(&mapMemory);
+    map.reserve(count);
+    for (const auto &name: staged) map.emplace(name, bytes);
+    const double mapBuild = elapsedMicros(start);
+
+    start = std::chrono::steady_clock::now();
+    StagingSnapshot snapshot;
+    snapshot.reserve(count);
+    for (const auto &name: staged) snapshot.stage(name, bytes);
+    snapshot.seal();
+    const double mphBuild = elapsedMicros(start);
+
+    std::vector<std::string_view> hits, misses;
+    for (std::size_t i = 0; i < 4096; ++i) {
+        hits.push_back(staged[i * 7919 % count]);
+        misses.push_back(loaded[i]);
+    }
+    const std::size_t mask = 4095;
+
+    benchReport("lookup", "unordered_map_hit/" + label, benchNsPerOp(iterations, [&](const std::size_t i) {
+        benchKeep(map.find(hits[i & mask]));
+    }));
+    benchReport("lookup", "perfect_hash_hit/" + label, benchNsPerOp(iterations, [&](const std::size_t i) {
+        benchKeep(snapshot.find(stagingKey(hits[i & mask])));
+    }));
+    benchReport("lookup", "unordered_map_miss/" + label, benchNsPerOp(iterations, [&](const std::size_t i) {
+        benchKeep(map.find(misses[i & mask]));
+    }));
+    benchReport("lookup", "perfect_hash_miss/" + label, benchNsPerOp(iterations, [&](const std::size_t i) {
+        benchKeep(snapshot.find(stagingKey(misses[i & mask])));
+    }));
+    printf("lookup/%-40s %10.1f us %10zu bytes\n", ("unordered_map_build/" + label).c_str(), mapBuild,
+           mapMemory.bytes);
+    printf("lookup/%-40s %10.1f us %10zu bytes\n", ("perfect_hash_build/" + label).c_str(), mphBuild,
+           snapshot.indexBytes());
+}
+
+int main(const int argc, char **argv) {
+    benchParseArgs(argc, argv);
+    for (const std::size_t count: {1000, 10000, 100000}) {
+        run(count);
+    }
+    return 0;
+}
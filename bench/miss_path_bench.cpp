@@ -0,0 +1,61 @@
+#include <memory_resource>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bench_util.h"
+#include "staging.h"
+
+// Compares the cost of an onClassLoad miss before and after the fast rejection
+// layer: the old hook locked a mutex, built a std::string and probed the map.
+
+static constexpr std::size_t iterations = 4'000'000;
+
+static std::pmr::unordered_map<std::string, std::vector<unsigned char> > legacyMap;
+static std::mutex legacyMutex;
+
+static bool legacyLookup(const char *name) {
+    std::lock_guard lock(legacyMutex);
+    return legacyMap.find(name) != legacyMap.end();
+}
+
+static bool currentLookup(const char *name) {
+    StagingKey key;
+    if (!stagingMayContain(name, key)) return false;
+    const StagingReadGuard guard;
+    const StagingSnapshot *snapshot = guard.snapshot();
+    return snapshot && snapshot->find(key);
+}
+
+static void stage(const std::vector<std::string> &names) {
+    auto next = std::make_unique<StagingSnapshot>();
+    legacyMap.clear();
+    for (const auto &name: names) {
+        next->stage(name, next->allocateBytes(16));
+        legacyMap[name] = std::vector<unsigned char>(16);
+    }
+    publishStagingSnapshot(std::move(next));
+}
+
+static void run(const std::size_t stagedCount, const std::vector<std::string> &loaded) {
+    stage(benchClassNames("com/example/patch", stagedCount));
+    const std::string label = std::to_string(stagedCount) + "_staged";
+    const std::size_t mask = loaded.size() - 1;
+
+    benchReport("miss_path", "legacy_mutex_map/" + label, benchNsPerOp(iterations, [&](const std::size_t i) {
+        benchKeep(legacyLookup(loaded[i & mask].c_str()));
+    }));
+    benchReport("miss_path", "snapshot_filter/" + label, benchNsPerOp(iterations, [&](const std::size_t i) {
+        benchKeep(currentLookup(loaded[i & mask].c_str()));
+    }));
+}
+
+int main(const int argc, char **argv) {
+    benchParseArgs(argc, argv);
+    const auto loaded = benchClassNames("org/springframework/context/support", 4096);
+    for (const std::size_t stagedCount: {0, 16, 1000, 10000}) {
+        run(stagedCount, loaded);
+    }
+    return 0;
+}
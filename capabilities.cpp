@@ -0,0 +1,95 @@
+#include "capabilities.h"
+
+#include <atomic>
+#include <mutex>
+
+#include "event_recorder.h"
+
+static std::atomic<jint> acquiredProfiles{0};
+static std::mutex acquireMutex;
+
+jvmtiCapabilities capabilitiesFor(const CapabilityProfile profile) {
+    jvmtiCapabilities caps{};
+    switch (profile) {
+        case CapabilityProfile::RedefineOnly:
+            caps.can_redefine_classes = 1;
+            break;
+        case CapabilityProfile::Retransform:
+            caps.can_retransform_classes = 1;
+            break;
+        case CapabilityProfile::Profiling:
+            caps.can_get_source_file_name = 1;
+            caps.can_get_line_numbers = 1;
+            caps.can_get_current_thread_cpu_time = 1;
+            caps.can_get_thread_cpu_time = 1;
+            caps.can_generate_compiled_method_load_events = 1;
+            break;
+        case CapabilityProfile::HeapAnalysis:
+            caps.can_tag_objects = 1;
+            caps.can_generate_object_free_events = 1;
+            break;
+    }
+    return caps;
+}
+
+jvmtiError acquireCapabilityProfile(jvmtiEnv *jvmti, const CapabilityProfile profile) {
+    const jint bit = 1 << static_cast<jint>(profile);
+    if (acquiredProfiles.load(std::memory_order_acquire) & bit) return JVMTI_ERROR_NONE;
+
+    std::lock_guard lock(acquireMutex);
+    if (acquiredProfiles.load(std::memory_order_relaxed) & bit) return JVMTI_ERROR_NONE;
+
+    static constexpr const char *profileNames[capabilityProfileCount] = {
+        "redefine_only", "retransform", "profiling", "heap_analysis"
+    };
+    const jvmtiCapabilities wanted = capabilitiesFor(profile);
+    const jvmtiError err = jvmti->AddCapabilities(&wanted);
+    if (err == JVMTI_ERROR_NONE) acquiredProfiles.fetch_or(bit, std::memory_order_release);
+    recordEvent({
+        .type = EventType::CapabilityChange, .flags = static_cast<std::uint16_t>(profile), .error = err,
+        .text = profileNames[static_cast<jint>(profile)]
+    });
+    return err;
+}
+
+jint acquiredCapabilityProfiles() {
+    return acquiredProfiles.load(std::memory_order_acquire);
+}
+
+// Spelled out because headers older than the VM do not declare the newer
+// JVMTI_VERSION_* constants.
+static constexpr jint jvmtiVersions[] = {
+    0x30150000, // 21
+    0x300B0000, // 11
+    0x30090000, // 9
+    0x30010200, // 1.2
+};
+
+jint obtainJvmti(JavaVM *vm, jvmtiEnv **env) {
+    for (const jint version: jvmtiVersions) {
+        if (vm->GetEnv(reinterpret_cast<void **>(env), version) == JNI_OK && *env) return version;
+    }
+    return 0;
+}
+
+template<typename Capabilities>
+static bool addVirtualThreadSupport(jvmtiEnv *jvmti, Capabilities &potential) {
+    if constexpr (requires { potential.can_support_virtual_threads; }) {
+        if (!potential.can_support_virtual_threads) return false;
+        Capabilities wanted{};
+        wanted.can_support_virtual_threads = 1;
+        const jvmtiError err = jvmti->AddCapabilities(&wanted);
+        recordEvent({
+            .type = EventType::CapabilityChange, .flags = 0xFFFF, .error = err, .text = "virtual_threads"
+        });
+        return err == JVMTI_ERROR_NONE;
+    } else {
+        return false;
+    }
+}
+
+bool acquireVirtualThreadSupport(jvmtiEnv *jvmti) {
+    jvmtiCapabilities potential{};
+    if (jvmti->GetPotentialCapabilities(&potential) != JVMTI_ERROR_NONE) return false;
+    return addVirtualThreadSupport(jvmti, potential);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <jvmti.h>
+
+// Capability presets. Each one requests only what its features need, so the
+// library never puts HotSpot into the slower modes that capabilities such as
+// can_access_local_variables or breakpoint/single-step events imply.
+// The values match the PROFILE_* constants on org.example.Native.
+enum class CapabilityProfile : jint {
+    RedefineOnly = 0,
+    Retransform = 1,
+    Profiling = 2,
+    HeapAnalysis = 3,
+};
+
+inline constexpr jint capabilityProfileCount = 4;
+
+jvmtiCapabilities capabilitiesFor(CapabilityProfile profile);
+
+// Adds the profile's capabilities the first time it is needed. Later calls
+// are a single atomic load.
+jvmtiError acquireCapabilityProfile(jvmtiEnv *jvmti, CapabilityProfile profile);
+
+// Bit i is set when profile i has been acquired.
+jint acquiredCapabilityProfiles();
+
+// Gets a JVMTI environment of the newest version the VM offers, from 21 down
+// to 1.2, and returns that version; 0 if the VM offers none of them.
+jint obtainJvmti(JavaVM *vm, jvmtiEnv **env);
+
+// Adds can_support_virtual_threads when both the headers the library was
+// built against and the VM know it. Without it, events are not delivered on
+// virtual threads and they cannot be the target of thread-scoped event
+// enabling.
+bool acquireVirtualThreadSupport(jvmtiEnv *jvmti);
@@ -0,0 +1,37 @@
+#include "class_cache.h"
+
+#include <mutex>
+#include <shared_mutex>
+#include <string_view>
+#include <unordered_map>
+
+#include "class_names.h"
+
+static std::shared_mutex cacheMutex;
+static std::unordered_map<std::string_view, jweak> classCache;
+
+jclass cachedFindClass(JNIEnv *env, const std::string &name) {
+    {
+        std::shared_lock lock(cacheMutex);
+        if (const auto it = classCache.find(name); it != classCache.end()) {
+            if (jobject cls = env->NewLocalRef(it->second)) return static_cast<jclass>(cls);
+        }
+    }
+
+    jclass cls = env->FindClass(name.c_str());
+    if (!cls && env->ExceptionCheck()) env->ExceptionClear();
+
+    std::lock_guard lock(cacheMutex);
+    const auto it = classCache.find(name);
+    if (it != classCache.end()) {
+        env->DeleteWeakGlobalRef(it->second);
+        if (!cls) {
+            classCache.erase(it);
+            return nullptr;
+        }
+        it->second = env->NewWeakGlobalRef(cls);
+    } else if (cls) {
+        classCache.emplace(internName(name), env->NewWeakGlobalRef(cls));
+    }
+    return cls;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <jni.h>
+
+#include <string>
+
+// Internal name to class, held as weak global references so the cache never
+// keeps a class alive. An entry whose class has been unloaded reads as a miss
+// and is dropped or replaced by the next lookup.
+//
+// Returns a new local reference, or nullptr if FindClass cannot see the class
+// from the caller's context. A failed FindClass leaves no exception pending.
+jclass cachedFindClass(JNIEnv *env, const std::string &name);
@@ -0,0 +1,40 @@
+#include "class_names.h"
+
+#include <memory_resource>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_set>
+
+static std::shared_mutex internMutex;
+static std::pmr::monotonic_buffer_resource internArena;
+static std::unordered_set<std::string_view> internedNames;
+
+std::string_view internName(const std::string_view name) {
+    {
+        std::shared_lock lock(internMutex);
+        if (const auto it = internedNames.find(name); it != internedNames.end()) return *it;
+    }
+
+    std::lock_guard lock(internMutex);
+    if (const auto it = internedNames.find(name); it != internedNames.end()) return *it;
+    auto *stored = static_cast<char *>(internArena.allocate(name.size() + 1, alignof(char)));
+    name.copy(stored, name.size());
+    stored[name.size()] = '\0';
+    return *internedNames.emplace(stored, name.size()).first;
+}
+
+std::string_view descriptorToInternalName(const std::string_view signature) {
+    if (signature.size() >= 2 && signature.front() == 'L' && signature.back() == ';') {
+        return signature.substr(1, signature.size() - 2);
+    }
+    return signature;
+}
+
+std::string_view internalClassName(jvmtiEnv *jvmti, jclass cls) {
+    char *signature = nullptr;
+    if (jvmti->GetClassSignature(cls, &signature, nullptr) != JVMTI_ERROR_NONE || !signature) return {};
+
+    const std::string_view name = internName(descriptorToInternalName(signature));
+    jvmti->Deallocate(reinterpret_cast<unsigned char *>(signature));
+    return name;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <jni.h>
+#include <jvmti.h>
+
+#include <string_view>
+
+// Process-wide table of class internal names. Every distinct name is stored
+// once and never freed, so the returned view can be held by the staging set,
+// the hook's snapshots and stats for the lifetime of the library.
+std::string_view internName(std::string_view name);
+
+// "Ljava/lang/String;" -> "java/lang/String". Array descriptors are already
+// their own internal name and are returned unchanged.
+std::string_view descriptorToInternalName(std::string_view signature);
+
+// Internal name of cls read with GetClassSignature, without calling into
+// Java. Empty if the signature cannot be read.
+std::string_view internalClassName(jvmtiEnv *jvmti, jclass cls);
@@ -0,0 +1,88 @@
+#include "content_hash.h"
+
+#include <cstring>
+
+static constexpr std::size_t laneCount = 8;
+static constexpr std::size_t stripeBytes = laneCount * sizeof(std::uint64_t);
+static constexpr std::size_t stripesPerBlock = 16;
+
+static constexpr std::uint64_t prime32a = 0x9E3779B1u;
+static constexpr std::uint64_t prime64a = 0x9E3779B185EBCA87ull;
+static constexpr std::uint64_t prime64b = 0xC2B2AE3D27D4EB4Full;
+static constexpr std::uint64_t prime64c = 0x165667B19E3779F9ull;
+
+static constexpr std::uint64_t laneKeys[laneCount] = {
+    0xbe4ba423396cfeb8ull, 0x1cad21f72c81017cull, 0xdb979083e96dd4deull, 0x1f67b3b7a4a44072ull,
+    0x78e5c0cc4ee679cbull, 0x2172ffcc7dd05a82ull, 0x8e2443f7744608b8ull, 0x4c263a81e69035e0ull,
+};
+
+static std::uint64_t load64(const unsigned char *p) {
+    std::uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static std::uint64_t mulFold64(const std::uint64_t a, const std::uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+    const __uint128_t product = static_cast<__uint128_t>(a) * b;
+    return static_cast<std::uint64_t>(product) ^ static_cast<std::uint64_t>(product >> 64);
+#else
+    const std::uint64_t lo = (a & 0xffffffff) * (b & 0xffffffff);
+    const std::uint64_t mid1 = (a >> 32) * (b & 0xffffffff);
+    const std::uint64_t mid2 = (a & 0xffffffff) * (b >> 32);
+    const std::uint64_t hi = (a >> 32) * (b >> 32);
+    const std::uint64_t cross = (lo >> 32) + (mid1 & 0xffffffff) + mid2;
+    return ((cross << 32) | (lo & 0xffffffff)) ^ (hi + (mid1 >> 32) + (cross >> 32));
+#endif
+}
+
+static std::uint64_t avalanche(std::uint64_t h) {
+    h ^= h >> 37;
+    h *= prime64c;
+    return h ^ (h >> 32);
+}
+
+// Like XXH3's sliding secret, the keys depend on the stripe's position in its
+// block so that equal data at different offsets contributes differently.
+static void accumulateStripe(std::uint64_t (&acc)[laneCount], const unsigned char *p, const std::uint64_t stripeKey) {
+    for (std::size_t i = 0; i < laneCount; ++i) {
+        const std::uint64_t data = load64(p + i * sizeof(std::uint64_t));
+        const std::uint64_t keyed = data ^ (laneKeys[i] + stripeKey);
+        acc[i ^ 1] += data;
+        acc[i] += (keyed & 0xffffffff) * (keyed >> 32);
+    }
+}
+
+static void scramble(std::uint64_t (&acc)[laneCount]) {
+    for (std::size_t i = 0; i < laneCount; ++i) {
+        acc[i] = (acc[i] ^ (acc[i] >> 47) ^ laneKeys[laneCount - 1 - i]) * prime32a;
+    }
+}
+
+std::uint64_t contentHash(const std::span<const unsigned char> bytes) {
+    const unsigned char *p = bytes.data();
+    std::size_t remaining = bytes.size();
+    const std::uint64_t length = remaining;
+
+    std::uint64_t acc[laneCount] = {
+        prime32a, prime64a, prime64b, prime64c, prime64a ^ prime64b, prime64b ^ prime64c, prime64c ^ prime32a,
+        prime64a ^ prime32a,
+    };
+
+    std::size_t stripes = 0;
+    for (; remaining >= stripeBytes; p += stripeBytes, remaining -= stripeBytes) {
+        accumulateStripe(acc, p, stripes % stripesPerBlock * prime64b);
+        if (++stripes % stripesPerBlock == 0) scramble(acc);
+    }
+    if (remaining > 0) {
+        unsigned char tail[stripeBytes] = {};
+        memcpy(tail, p, remaining);
+        accumulateStripe(acc, tail, stripes % stripesPerBlock * prime64b);
+    }
+
+    std::uint64_t h = length * prime64a;
+    for (std::size_t i = 0; i < laneCount; i += 2) {
+        h += mulFold64(acc[i] ^ laneKeys[i], acc[i + 1] ^ laneKeys[i + 1]);
+    }
+    return avalanche(h);
+}
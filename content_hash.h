@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+// Fast 64-bit content hash of a class file. The bulk loop follows XXH3's
+// accumulate/scramble structure (eight independent 64-bit lanes fed by
+// 32x32->64 multiplies) so compilers emit SIMD for it; the output is not
+// compatible with XXH3 and is only meant for change detection.
+std::uint64_t contentHash(std::span<const unsigned char> bytes);
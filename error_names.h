@@ -0,0 +1,7 @@
+#pragma once
+
+#include <jvmti.h>
+
+// Symbolic name of err, e.g. "JVMTI_ERROR_INVALID_CLASS"; "Unknown JVMTI error"
+// for codes this library does not know.
+const char *getErrorName(jvmtiError err);
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// On-disk layout of the event recorder's ring file, shared with the decoder.
+// A header is followed by capacity fixed-size records; record i holds the
+// event written at every position p with p % capacity == i, so the file
+// always keeps the latest capacity events. All fields are little-endian as
+// written by the recording host.
+
+inline constexpr char eventFileMagic[8] = {'J', 'N', 'I', 'E', 'V', 'T', '0', '1'};
+inline constexpr std::uint32_t eventFileVersion = 1;
+
+enum class EventType : std::uint16_t {
+    // A ClassFileLoadHook substitution. flags: the StagingChannel that
+    // matched; text: the class name.
+    HookHit = 1,
+    // One RedefineClasses call. count: classes; bytes: class file bytes.
+    Redefine = 2,
+    // One RetransformClasses call outside a staging commit.
+    Retransform = 3,
+    // A capability profile added. flags: the CapabilityProfile, or 0xFFFF
+    // for can_support_virtual_threads; text: its name.
+    CapabilityChange = 4,
+    // A staging-set commit. count: classes retransformed; flags: how many of
+    // them were restored to their original bytes, saturated at 0xFFFF.
+    StagingCommit = 5,
+};
+
+struct alignas(64) EventFileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t recordSize;
+    std::uint64_t capacity;
+    // Unix time at which the file was created, in nanoseconds.
+    std::int64_t createdNanos;
+    // Positions handed out so far; the next event goes to next % capacity.
+    std::atomic<std::uint64_t> next;
+};
+
+struct alignas(64) EventRecord {
+    static constexpr std::size_t textCapacity = 80;
+
+    // Position + 1 once the record is complete; 0 while it is being written.
+    std::atomic<std::uint64_t> sequence;
+    // Unix time in nanoseconds.
+    std::int64_t timeNanos;
+    std::int64_t durationNanos;
+    std::uint64_t bytes;
+    EventType type;
+    std::uint16_t flags;
+    // jvmtiError of the operation, 0 on success.
+    std::int32_t error;
+    std::uint32_t count;
+    // Small per-process id of the writing thread.
+    std::uint32_t thread;
+    // NUL-terminated; long names keep their end, prefixed with "..".
+    char text[textCapacity];
+};
+
+static_assert(sizeof(EventFileHeader) == 64);
+static_assert(sizeof(EventRecord) == 128);
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free);
@@ -0,0 +1,192 @@
+#include "event_recorder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// One mapped ring file, unmapped once no writer can still be using it.
+struct EventMapping {
+    EventFileHeader *header;
+    EventRecord *records;
+    std::uint64_t capacity;
+    std::size_t size;
+};
+
+static std::mutex recorderMutex;
+static std::atomic<EventMapping *> activeMapping{nullptr};
+
+// Writers in recordEvent(), counted under the parity of writerEpoch they
+// saw. Retiring a mapping flips the epoch and waits for the old parity to
+// drain, twice, so steady logging cannot keep it waiting: new writers count
+// under the other parity, and they can only load the replacement.
+static std::atomic<unsigned> writerEpoch{0};
+static std::atomic<std::uint32_t> activeWriters[2];
+
+static std::int64_t unixNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static void *mapEventFile(const std::string &path, const std::size_t size) {
+#ifdef _WIN32
+    const HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                                    CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return nullptr;
+    const auto wide = static_cast<std::uint64_t>(size);
+    const HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, static_cast<DWORD>(wide >> 32),
+                                              static_cast<DWORD>(wide), nullptr);
+    CloseHandle(file);
+    if (!mapping) return nullptr;
+    // The view keeps the mapping and the file open.
+    void *view = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size);
+    CloseHandle(mapping);
+    return view;
+#else
+    const int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return nullptr;
+    void *view = nullptr;
+    if (ftruncate(fd, static_cast<off_t>(size)) == 0) {
+        view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (view == MAP_FAILED) view = nullptr;
+    }
+    close(fd);
+    return view;
+#endif
+}
+
+// The descriptor or file handle is closed as soon as the view exists, so
+// the view is all there is to release.
+static void unmapEventFile(const EventMapping &mapping) {
+#ifdef _WIN32
+    FlushViewOfFile(mapping.header, mapping.size);
+    UnmapViewOfFile(mapping.header);
+#else
+    msync(mapping.header, mapping.size, MS_SYNC);
+    munmap(mapping.header, mapping.size);
+#endif
+}
+
+// Unpublishes the active mapping, waits out the writers that may hold it,
+// then flushes and unmaps it. Caller holds recorderMutex.
+static void retireActiveMapping() {
+    EventMapping *previous = activeMapping.exchange(nullptr);
+    if (!previous) return;
+    for (int flip = 0; flip < 2; ++flip) {
+        const unsigned parity = writerEpoch.fetch_add(1) & 1;
+        while (activeWriters[parity].load(std::memory_order_acquire) != 0) std::this_thread::yield();
+    }
+    unmapEventFile(*previous);
+    delete previous;
+}
+
+bool openEventRecorder(const std::string &path, const std::size_t capacity) {
+    if (path.empty() || capacity == 0 || capacity > (std::size_t{1} << 24)) return false;
+    std::lock_guard lock(recorderMutex);
+    retireActiveMapping();
+
+    const std::size_t size = sizeof(EventFileHeader) + capacity * sizeof(EventRecord);
+    void *view = mapEventFile(path, size);
+    if (!view) return false;
+
+    // The file is freshly truncated, so every record starts zeroed: an
+    // unwritten slot reads as sequence 0.
+    auto *header = new (view) EventFileHeader{};
+    std::memcpy(header->magic, eventFileMagic, sizeof(header->magic));
+    header->version = eventFileVersion;
+    header->recordSize = sizeof(EventRecord);
+    header->capacity = capacity;
+    header->createdNanos = unixNanos();
+    activeMapping.store(new EventMapping{header, reinterpret_cast<EventRecord *>(header + 1), capacity, size},
+                        std::memory_order_release);
+    return true;
+}
+
+void closeEventRecorder() {
+    std::lock_guard lock(recorderMutex);
+    retireActiveMapping();
+}
+
+bool eventRecorderActive() {
+    return activeMapping.load(std::memory_order_relaxed) != nullptr;
+}
+
+static std::uint32_t eventThreadId() {
+    static std::atomic<std::uint32_t> nextThreadId{1};
+    thread_local const std::uint32_t id = nextThreadId.fetch_add(1, std::memory_order_relaxed);
+    return id;
+}
+
+static void writeEvent(const EventMapping &mapping, const EventFields &event) {
+    const std::uint64_t position = mapping.header->next.fetch_add(1, std::memory_order_relaxed);
+    EventRecord &record = mapping.records[position % mapping.capacity];
+    // A reader skips the record until the sequence is stored again below.
+    record.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    record.timeNanos = unixNanos();
+    record.durationNanos = event.duration.count();
+    record.bytes = event.bytes;
+    record.type = event.type;
+    record.flags = event.flags;
+    record.error = static_cast<std::int32_t>(event.error);
+    record.count = event.count;
+    record.thread = eventThreadId();
+
+    std::string_view text = event.text;
+    std::size_t used = 0;
+    if (text.size() >= EventRecord::textCapacity) {
+        record.text[used++] = '.';
+        record.text[used++] = '.';
+        text = text.substr(text.size() - (EventRecord::textCapacity - 1 - used));
+    }
+    std::memcpy(record.text + used, text.data(), text.size());
+    record.text[used + text.size()] = '\0';
+
+    record.sequence.store(position + 1, std::memory_order_release);
+}
+
+void recordEvent(const EventFields &event) {
+    if (!eventRecorderActive()) return;
+    const unsigned parity = writerEpoch.load() & 1;
+    activeWriters[parity].fetch_add(1);
+    // Loaded after the count is raised, so a retiring close waits for this
+    // writer or this load already sees the mapping gone.
+    if (const EventMapping *mapping = activeMapping.load()) writeEvent(*mapping, event);
+    activeWriters[parity].fetch_sub(1, std::memory_order_release);
+}
+
+jvmtiError recordedRedefineClasses(jvmtiEnv *jvmti, const jint count, const jvmtiClassDefinition *definitions) {
+    if (!eventRecorderActive()) return jvmti->RedefineClasses(count, definitions);
+
+    const auto started = std::chrono::steady_clock::now();
+    const jvmtiError err = jvmti->RedefineClasses(count, definitions);
+    std::uint64_t bytes = 0;
+    for (jint i = 0; i < count; ++i) bytes += static_cast<std::uint64_t>(definitions[i].class_byte_count);
+    recordEvent({
+        .type = EventType::Redefine, .error = err, .count = static_cast<std::uint32_t>(count), .bytes = bytes,
+        .duration = std::chrono::steady_clock::now() - started
+    });
+    return err;
+}
+
+jvmtiError recordedRetransformClasses(jvmtiEnv *jvmti, const jint count, const jclass *classes) {
+    if (!eventRecorderActive()) return jvmti->RetransformClasses(count, classes);
+
+    const auto started = std::chrono::steady_clock::now();
+    const jvmtiError err = jvmti->RetransformClasses(count, classes);
+    recordEvent({
+        .type = EventType::Retransform, .error = err, .count = static_cast<std::uint32_t>(count),
+        .duration = std::chrono::steady_clock::now() - started
+    });
+    return err;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <jvmti.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "event_format.h"
+
+// Timeline of what the library did, written into a memory-mapped ring file
+// (see event_format.h) for post-mortem analysis. Recording an event claims a
+// position with one atomic add and fills the record in place: no lock and
+// no system call. The OS writes the pages back, so the file survives a
+// crash of the process.
+
+// Creates or truncates path to hold capacity records and starts recording
+// into it, closing any previous file first.
+bool openEventRecorder(const std::string &path, std::size_t capacity);
+
+// Stops recording, waits for events still being written, then flushes and
+// unmaps the file.
+void closeEventRecorder();
+
+// Cheap check callers can use to skip preparing an event.
+bool eventRecorderActive();
+
+struct EventFields {
+    EventType type;
+    std::uint16_t flags = 0;
+    jvmtiError error = JVMTI_ERROR_NONE;
+    std::uint32_t count = 0;
+    std::uint64_t bytes = 0;
+    std::chrono::nanoseconds duration{0};
+    std::string_view text{};
+};
+
+void recordEvent(const EventFields &event);
+
+// RedefineClasses, recorded as a Redefine event with its duration and
+// outcome.
+jvmtiError recordedRedefineClasses(jvmtiEnv *jvmti, jint count, const jvmtiClassDefinition *definitions);
+
+// RetransformClasses, recorded as a Retransform event.
+jvmtiError recordedRetransformClasses(jvmtiEnv *jvmti, jint count, const jclass *classes);
@@ -0,0 +1,106 @@
+#include "first_load.h"
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+#include "loader_ids.h"
+#include "staging.h"
+
+struct FirstLoadDefinition {
+    std::shared_ptr<const std::vector<unsigned char> > bytes;
+    // Shared with every snapshot the entry is published in, so an entry the
+    // hook consumed in one snapshot stays consumed in the next.
+    std::shared_ptr<StagedEntryState> state = std::make_shared<StagedEntryState>(true);
+};
+
+static std::mutex firstLoadMutex;
+static std::unordered_map<StagedKey, FirstLoadDefinition, StagedKeyHash> definitions;
+
+// Each entry leaves the count exactly once: when the hook claims it, or when
+// it is replaced or cleared, which claims it first so it cannot fire later.
+static std::atomic<std::size_t> unfiredCount{0};
+
+static bool fired(const FirstLoadDefinition &definition) {
+    return definition.state->claimed.load(std::memory_order_acquire);
+}
+
+static void retire(const FirstLoadDefinition &definition, std::vector<std::string_view> *unfired,
+                   const std::string_view name) {
+    if (definition.state->claimed.exchange(true, std::memory_order_acq_rel)) return;
+    unfiredCount.fetch_sub(1, std::memory_order_acq_rel);
+    if (unfired) unfired->push_back(name);
+}
+
+// Drops consumed entries and publishes the rest. Each key pins its loader
+// reference, which nothing else keeps alive, until no snapshot holds it.
+static void republish() {
+    std::vector<jweak> released;
+    for (auto it = definitions.begin(); it != definitions.end();) {
+        if (fired(it->second)) {
+            released.push_back(it->first.loader);
+            it = definitions.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    std::unique_ptr<StagingSnapshot> next;
+    if (!definitions.empty()) {
+        next = std::make_unique<StagingSnapshot>();
+        next->reserve(definitions.size());
+        for (const auto &[key, definition]: definitions) {
+            next->stageInterned(key.name, *definition.bytes, key.loader, key.anyLoader, definition.state);
+            next->ownedBytes.push_back(definition.bytes);
+        }
+    }
+    publishStagingSnapshot(std::move(next), StagingChannel::FirstLoad);
+    for (const jweak loader: released) unpinCanonicalLoader(loader);
+}
+
+void addFirstLoadDefinition(const StagedKey &key, std::shared_ptr<const std::vector<unsigned char> > bytes) {
+    std::lock_guard lock(firstLoadMutex);
+    if (const auto it = definitions.find(key); it != definitions.end()) {
+        retire(it->second, nullptr, key.name);
+        it->second = {std::move(bytes)};
+    } else {
+        pinCanonicalLoader(key.loader);
+        definitions.emplace(key, FirstLoadDefinition{std::move(bytes)});
+    }
+    // Counted before it is published, so the hook cannot claim it first.
+    unfiredCount.fetch_add(1, std::memory_order_acq_rel);
+    republish();
+}
+
+void unfiredFirstLoadDefinitions(std::vector<std::string_view> &unfired) {
+    std::lock_guard lock(firstLoadMutex);
+    republish();
+    for (const auto &[key, definition]: definitions) {
+        if (!fired(definition)) unfired.push_back(key.name);
+    }
+}
+
+void clearFirstLoadDefinitions(std::vector<std::string_view> &unfired) {
+    std::lock_guard lock(firstLoadMutex);
+    // Retire the snapshot first so no load can fire an entry after it has
+    // been reported.
+    publishStagingSnapshot(nullptr, StagingChannel::FirstLoad);
+    for (const auto &[key, definition]: definitions) {
+        retire(definition, &unfired, key.name);
+        unpinCanonicalLoader(key.loader);
+    }
+    definitions.clear();
+}
+
+std::size_t pendingFirstLoadDefinitions() {
+    return unfiredCount.load(std::memory_order_acquire);
+}
+
+bool firstLoadDefinitionFired() {
+    return unfiredCount.fetch_sub(1, std::memory_order_acq_rel) == 1;
+}
+
+void sweepFirstLoadDefinitions() {
+    std::lock_guard lock(firstLoadMutex);
+    republish();
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "staged_classes.h"
+
+// Class files registered by name for classes that have not been loaded yet.
+// They are published on the FirstLoad staging channel, and the hook
+// substitutes an entry the first time a matching class is loaded, with no
+// retransform. Each entry is consumed by the load it fires for.
+//
+// The three calls below drop consumed entries and republish.
+void addFirstLoadDefinition(const StagedKey &key, std::shared_ptr<const std::vector<unsigned char> > bytes);
+
+// Fills unfired with the names of entries that have not fired yet.
+void unfiredFirstLoadDefinitions(std::vector<std::string_view> &unfired);
+
+// Removes every entry, reporting the ones that never fired.
+void clearFirstLoadDefinitions(std::vector<std::string_view> &unfired);
+
+// Entries that can still fire. Kept exact without the lock, so the hook
+// holds global delivery exactly while it is nonzero.
+std::size_t pendingFirstLoadDefinitions();
+
+// Called by the hook after it claimed an entry; true when that was the last
+// pending one, so the consumed entries should be swept.
+bool firstLoadDefinitionFired();
+
+// Drops consumed entries and republishes the rest. Takes the lock, so it
+// must not run on the hook's thread.
+void sweepFirstLoadDefinitions();
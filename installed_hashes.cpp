@@ -0,0 +1,74 @@
+#include "installed_hashes.h"
+
+#include <mutex>
+#include <unordered_map>
+
+#include "content_hash.h"
+
+struct InstalledHash {
+    jweak cls;
+    std::uint64_t hash;
+};
+
+static std::mutex installedMutex;
+static std::unordered_multimap<jint, InstalledHash> installedHashes;
+
+// Finds the entry for cls among those sharing its identity hash, dropping
+// entries whose class has been unloaded along the way.
+static std::unordered_multimap<jint, InstalledHash>::iterator findInstalled(JNIEnv *env, const jint identity, jclass cls) {
+    auto [it, last] = installedHashes.equal_range(identity);
+    while (it != last) {
+        if (env->IsSameObject(it->second.cls, nullptr)) {
+            env->DeleteWeakGlobalRef(it->second.cls);
+            it = installedHashes.erase(it);
+        } else if (env->IsSameObject(it->second.cls, cls)) {
+            return it;
+        } else {
+            ++it;
+        }
+    }
+    return installedHashes.end();
+}
+
+static jint identityOf(jvmtiEnv *jvmti, jclass cls) {
+    jint identity = 0;
+    jvmti->GetObjectHashCode(cls, &identity);
+    return identity;
+}
+
+bool installedHashMatches(JNIEnv *env, jvmtiEnv *jvmti, jclass cls, const std::uint64_t hash) {
+    const jint identity = identityOf(jvmti, cls);
+    std::lock_guard lock(installedMutex);
+    const auto it = findInstalled(env, identity, cls);
+    return it != installedHashes.end() && it->second.hash == hash;
+}
+
+void recordInstalledHash(JNIEnv *env, jvmtiEnv *jvmti, jclass cls, const std::uint64_t hash) {
+    const jint identity = identityOf(jvmti, cls);
+    std::lock_guard lock(installedMutex);
+    if (const auto it = findInstalled(env, identity, cls); it != installedHashes.end()) {
+        it->second.hash = hash;
+        return;
+    }
+    installedHashes.emplace(identity, InstalledHash{env->NewWeakGlobalRef(cls), hash});
+}
+
+void recordInstalledDefinitions(JNIEnv *env, jvmtiEnv *jvmti, const std::span<const jvmtiClassDefinition> defs) {
+    for (const auto &def: defs) {
+        if (!def.klass || !def.class_bytes) continue;
+        recordInstalledHash(env, jvmti, def.klass,
+                            contentHash({def.class_bytes, static_cast<std::size_t>(def.class_byte_count)}));
+    }
+}
+
+void forgetInstalledHashes(JNIEnv *env, jvmtiEnv *jvmti, const std::span<const jclass> classes) {
+    for (jclass cls: classes) {
+        if (!cls) continue;
+        const jint identity = identityOf(jvmti, cls);
+        std::lock_guard lock(installedMutex);
+        if (const auto it = findInstalled(env, identity, cls); it != installedHashes.end()) {
+            env->DeleteWeakGlobalRef(it->second.cls);
+            installedHashes.erase(it);
+        }
+    }
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <jvmti.h>
+
+#include <cstdint>
+#include <span>
+
+// Remembers the content hash of the bytes this library last installed for
+// each class, keyed by class identity through weak references. Every path
+// that redefines or retransforms a class must record or forget it here, or
+// a later redefineChangedClasses call could skip it wrongly.
+bool installedHashMatches(JNIEnv *env, jvmtiEnv *jvmti, jclass cls, std::uint64_t hash);
+
+void recordInstalledHash(JNIEnv *env, jvmtiEnv *jvmti, jclass cls, std::uint64_t hash);
+
+void recordInstalledDefinitions(JNIEnv *env, jvmtiEnv *jvmti, std::span<const jvmtiClassDefinition> defs);
+
+// Used after a retransform, whose result also depends on other agents.
+void forgetInstalledHashes(JNIEnv *env, jvmtiEnv *jvmti, std::span<const jclass> classes);
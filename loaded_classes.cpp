@@ -0,0 +1,282 @@
+#include "loaded_classes.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+#include "capabilities.h"
+#include "class_names.h"
+#include "native_log.h"
+
+struct LoadedClass {
+    jweak cls;
+    jweak loader;
+    std::string_view name;
+    jint loaderHash;
+};
+
+// Tags handed out to classes carry this bit so ObjectFree can tell them from
+// objects other parts of the library tag.
+static constexpr jlong classTagBit = jlong{1} << 56;
+
+// Unbounded stack that event callbacks push to without locking and the index
+// takes whole under indexMutex; taking everything at once leaves no ABA window.
+template<typename T>
+class PendingStack {
+public:
+    void push(T value) {
+        auto *node = new Node{std::move(value), head_.load(std::memory_order_relaxed)};
+        while (!head_.compare_exchange_weak(node->next, node, std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+        }
+    }
+
+    // Oldest first.
+    std::vector<T> takeAll() {
+        std::vector<T> values;
+        for (Node *node = head_.exchange(nullptr, std::memory_order_acquire); node;) {
+            values.push_back(std::move(node->value));
+            delete std::exchange(node, node->next);
+        }
+        std::ranges::reverse(values);
+        return values;
+    }
+
+private:
+    struct Node {
+        T value;
+        Node *next;
+    };
+
+    std::atomic<Node *> head_{nullptr};
+};
+
+static std::mutex indexMutex;
+static std::atomic<bool> indexReady{false};
+static jvmtiEnv *indexJvmti = nullptr;
+static bool tagging = false;
+static std::uint64_t nextEntryId = 1;
+static std::unordered_map<std::uint64_t, LoadedClass> entries;
+static std::multimap<std::string_view, std::uint64_t> byName;
+static std::unordered_multimap<jint, std::uint64_t> byLoader;
+
+// Filled by ClassPrepare and ObjectFree, which may run on virtual threads and
+// inside GC respectively, and must not wait for a query holding indexMutex.
+static PendingStack<jweak> preparedClasses;
+static PendingStack<std::uint64_t> freedEntries;
+
+// Past this many queued classes the ClassPrepare thread applies the queue
+// itself when the index is free, so a process that rarely queries does not
+// pile up weak references.
+static constexpr std::size_t preparedDrainThreshold = 1024;
+static std::atomic<std::size_t> preparedBacklog{0};
+
+static jint identityOf(jvmtiEnv *jvmti, jobject obj) {
+    jint identity = 0;
+    if (obj) jvmti->GetObjectHashCode(obj, &identity);
+    return identity;
+}
+
+template<typename Map>
+static void eraseIndexed(Map &map, const typename Map::key_type &key, const std::uint64_t id) {
+    auto [it, last] = map.equal_range(key);
+    for (; it != last; ++it) {
+        if (it->second == id) {
+            map.erase(it);
+            return;
+        }
+    }
+}
+
+static void eraseEntry(JNIEnv *env, const std::uint64_t id) {
+    const auto it = entries.find(id);
+    if (it == entries.end()) return;
+
+    const LoadedClass &entry = it->second;
+    eraseIndexed(byName, entry.name, id);
+    eraseIndexed(byLoader, entry.loaderHash, id);
+    env->DeleteWeakGlobalRef(entry.cls);
+    if (entry.loader) env->DeleteWeakGlobalRef(entry.loader);
+    entries.erase(it);
+}
+
+// Releases entries whose classes ObjectFree reported since the last call.
+static void drainFreed(JNIEnv *env) {
+    for (const std::uint64_t id: freedEntries.takeAll()) eraseEntry(env, id);
+}
+
+// Adds cls unless it is already indexed.
+static void indexClass(JNIEnv *env, jvmtiEnv *jvmti, jclass cls) {
+    const std::string_view name = internalClassName(jvmti, cls);
+    if (name.empty()) return;
+
+    auto [it, last] = byName.equal_range(name);
+    while (it != last) {
+        const std::uint64_t id = it->second;
+        ++it;
+        const jweak seen = entries.at(id).cls;
+        if (env->IsSameObject(seen, nullptr)) {
+            eraseEntry(env, id);
+        } else if (env->IsSameObject(seen, cls)) {
+            return;
+        }
+    }
+
+    jobject loader = nullptr;
+    jvmti->GetClassLoader(cls, &loader);
+    const std::uint64_t id = nextEntryId++;
+    const LoadedClass entry{env->NewWeakGlobalRef(cls), loader ? env->NewWeakGlobalRef(loader) : nullptr, name,
+                            identityOf(jvmti, loader)};
+    if (loader) env->DeleteLocalRef(loader);
+
+    entries.emplace(id, entry);
+    byName.emplace(name, id);
+    byLoader.emplace(entry.loaderHash, id);
+    if (tagging) jvmti->SetTag(cls, classTagBit | static_cast<jlong>(id));
+}
+
+bool ensureLoadedClassIndex(JNIEnv *env, jvmtiEnv *jvmti) {
+    if (indexReady.load(std::memory_order_acquire)) return true;
+
+    std::lock_guard lock(indexMutex);
+    if (indexReady.load(std::memory_order_relaxed)) return true;
+
+    indexJvmti = jvmti;
+    tagging = acquireCapabilityProfile(jvmti, CapabilityProfile::HeapAnalysis) == JVMTI_ERROR_NONE &&
+              jvmti->SetEventNotificationMode(JVMTI_ENABLE, JVMTI_EVENT_OBJECT_FREE, nullptr) == JVMTI_ERROR_NONE;
+    // Enable ClassPrepare before the snapshot so no class falls in between;
+    // classes seen twice are deduplicated by indexClass.
+    if (jvmti->SetEventNotificationMode(JVMTI_ENABLE, JVMTI_EVENT_CLASS_PREPARE, nullptr) != JVMTI_ERROR_NONE) {
+        nativeLog(LogLevel::Error, "[-] Failed to enable ClassPrepare events");
+        return false;
+    }
+    indexReady.store(true, std::memory_order_release);
+
+    jint count = 0;
+    jclass *classes = nullptr;
+    if (jvmti->GetLoadedClasses(&count, &classes) != JVMTI_ERROR_NONE) return true;
+    for (jint i = 0; i < count; ++i) {
+        jint status = 0;
+        jvmti->GetClassStatus(classes[i], &status);
+        if ((status & JVMTI_CLASS_STATUS_PREPARED) &&
+            !(status & (JVMTI_CLASS_STATUS_ARRAY | JVMTI_CLASS_STATUS_PRIMITIVE))) {
+            indexClass(env, jvmti, classes[i]);
+        }
+        env->DeleteLocalRef(classes[i]);
+    }
+    jvmti->Deallocate(reinterpret_cast<unsigned char *>(classes));
+    nativeLog(LogLevel::Info, "[*] Indexed %zu loaded classes", entries.size());
+    return true;
+}
+
+void closeLoadedClassIndex(JNIEnv *env, jvmtiEnv *jvmti) {
+    std::lock_guard lock(indexMutex);
+    if (!indexReady.load(std::memory_order_relaxed)) return;
+
+    jvmti->SetEventNotificationMode(JVMTI_DISABLE, JVMTI_EVENT_CLASS_PREPARE, nullptr);
+    if (tagging) jvmti->SetEventNotificationMode(JVMTI_DISABLE, JVMTI_EVENT_OBJECT_FREE, nullptr);
+    indexReady.store(false, std::memory_order_release);
+
+    // Events already in flight may still queue entries; ids are never reused
+    // and prepared classes are deduplicated, so a rebuild applies them safely.
+    drainFreed(env);
+    for (const auto &[id, entry]: entries) {
+        if (jobject cls = tagging ? env->NewLocalRef(entry.cls) : nullptr) {
+            jvmti->SetTag(cls, 0);
+            env->DeleteLocalRef(cls);
+        }
+        env->DeleteWeakGlobalRef(entry.cls);
+        if (entry.loader) env->DeleteWeakGlobalRef(entry.loader);
+    }
+    nativeLog(LogLevel::Info, "[*] Closed loaded class index of %zu classes", entries.size());
+    entries.clear();
+    byName.clear();
+    byLoader.clear();
+    const std::vector<jweak> prepared = preparedClasses.takeAll();
+    preparedBacklog.fetch_sub(prepared.size(), std::memory_order_relaxed);
+    for (const jweak weak: prepared) env->DeleteWeakGlobalRef(weak);
+}
+
+static void drainPending(JNIEnv *env);
+
+void loadedClassPrepared(JNIEnv *env, jclass cls) {
+    if (!indexReady.load(std::memory_order_acquire)) return;
+    preparedClasses.push(env->NewWeakGlobalRef(cls));
+    if (preparedBacklog.fetch_add(1, std::memory_order_relaxed) + 1 < preparedDrainThreshold) return;
+    // Never waits: whoever holds the lock is a query that drains anyway.
+    std::unique_lock lock(indexMutex, std::try_to_lock);
+    if (lock.owns_lock() && indexReady.load(std::memory_order_relaxed)) drainPending(env);
+}
+
+void loadedClassFreed(const jlong tag) {
+    if (!(tag & classTagBit)) return;
+    freedEntries.push(static_cast<std::uint64_t>(tag & ~classTagBit));
+}
+
+// Brings the index up to date with the events queued since the last query.
+// Caller holds indexMutex.
+static void drainPending(JNIEnv *env) {
+    drainFreed(env);
+    const std::vector<jweak> prepared = preparedClasses.takeAll();
+    preparedBacklog.fetch_sub(prepared.size(), std::memory_order_relaxed);
+    for (const jweak weak: prepared) {
+        if (jobject cls = env->NewLocalRef(weak)) {
+            indexClass(env, indexJvmti, static_cast<jclass>(cls));
+            env->DeleteLocalRef(cls);
+        }
+        env->DeleteWeakGlobalRef(weak);
+    }
+}
+
+// Appends a local reference to the entry's class, or drops the entry if the
+// class is gone.
+static bool collect(JNIEnv *env, const std::uint64_t id, std::vector<jclass> &out) {
+    const auto it = entries.find(id);
+    if (it == entries.end()) return false;
+    if (jobject cls = env->NewLocalRef(it->second.cls)) {
+        out.push_back(static_cast<jclass>(cls));
+        return true;
+    }
+    eraseEntry(env, id);
+    return false;
+}
+
+template<typename Range>
+static std::vector<jclass> collectAll(JNIEnv *env, const Range &ids) {
+    std::vector<jclass> out;
+    for (const std::uint64_t id: ids) collect(env, id, out);
+    return out;
+}
+
+std::vector<jclass> findLoadedClasses(JNIEnv *env, const std::string_view name) {
+    std::lock_guard lock(indexMutex);
+    drainPending(env);
+    std::vector<std::uint64_t> ids;
+    for (auto [it, last] = byName.equal_range(name); it != last; ++it) ids.push_back(it->second);
+    return collectAll(env, ids);
+}
+
+std::vector<jclass> findLoadedClassesWithPrefix(JNIEnv *env, const std::string_view prefix) {
+    std::lock_guard lock(indexMutex);
+    drainPending(env);
+    std::vector<std::uint64_t> ids;
+    for (auto it = byName.lower_bound(prefix); it != byName.end() && it->first.starts_with(prefix); ++it) {
+        ids.push_back(it->second);
+    }
+    return collectAll(env, ids);
+}
+
+std::vector<jclass> findLoadedClassesOfLoader(JNIEnv *env, jvmtiEnv *jvmti, jobject loader) {
+    std::lock_guard lock(indexMutex);
+    drainPending(env);
+    std::vector<std::uint64_t> ids;
+    for (auto [it, last] = byLoader.equal_range(identityOf(jvmti, loader)); it != last; ++it) {
+        const jweak candidate = entries.at(it->second).loader;
+        if (loader ? candidate && env->IsSameObject(candidate, loader) : !candidate) ids.push_back(it->second);
+    }
+    return collectAll(env, ids);
+}
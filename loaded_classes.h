@@ -0,0 +1,39 @@
+#pragma once
+
+#include <jni.h>
+#include <jvmti.h>
+
+#include <string_view>
+#include <vector>
+
+// Index of the classes the VM has loaded, seeded once from GetLoadedClasses
+// and kept current from ClassPrepare events. Classes are held as weak global
+// references. With the HeapAnalysis profile each class is also tagged, and
+// its entry is dropped when ObjectFree reports the tag; without it, entries
+// of unloaded classes are dropped when a lookup walks over them.
+//
+// Builds the index on first use; later calls are a single atomic load. The
+// index enables ClassPrepare, and ObjectFree when tagging, for the whole VM
+// and keeps them on until closeLoadedClassIndex.
+bool ensureLoadedClassIndex(JNIEnv *env, jvmtiEnv *jvmti);
+
+// Disables the index's events, untags its classes and releases every entry.
+// A later ensureLoadedClassIndex builds it again from GetLoadedClasses.
+void closeLoadedClassIndex(JNIEnv *env, jvmtiEnv *jvmti);
+
+// Event entry points, called from the library's JVMTI callbacks. Neither
+// blocks: events are queued and applied to the index by the next lookup, or
+// by a ClassPrepare event that finds a long queue and the index unlocked.
+void loadedClassPrepared(JNIEnv *env, jclass cls);
+
+// Runs during GC and may not use JNI; the entry is released by the next
+// index operation. Ignores tags the index did not hand out.
+void loadedClassFreed(jlong tag);
+
+// Lookups return new local references the caller deletes. Names are
+// internal names; a null loader means the bootstrap loader.
+std::vector<jclass> findLoadedClasses(JNIEnv *env, std::string_view name);
+
+std::vector<jclass> findLoadedClassesWithPrefix(JNIEnv *env, std::string_view prefix);
+
+std::vector<jclass> findLoadedClassesOfLoader(JNIEnv *env, jvmtiEnv *jvmti, jobject loader);
@@ -0,0 +1,68 @@
+#include "loader_ids.h"
+
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+
+static std::mutex loaderMutex;
+static std::unordered_multimap<jint, jweak> loaders;
+static std::unordered_map<jweak, std::size_t> pins;
+// A full sweep runs when the table doubles, keeping inserts amortized O(1).
+static std::size_t sweepAt = 64;
+
+static bool collected(JNIEnv *env, const jweak ref) {
+    return env->IsSameObject(ref, nullptr) && !pins.contains(ref);
+}
+
+// Caller holds loaderMutex.
+static void sweepCollectedLoaders(JNIEnv *env) {
+    for (auto it = loaders.begin(); it != loaders.end();) {
+        if (collected(env, it->second)) {
+            env->DeleteWeakGlobalRef(it->second);
+            it = loaders.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    sweepAt = std::max<std::size_t>(64, loaders.size() * 2);
+}
+
+jweak canonicalLoader(JNIEnv *env, jvmtiEnv *jvmti, jobject loader) {
+    if (!loader) return nullptr;
+
+    jint identity = 0;
+    jvmti->GetObjectHashCode(loader, &identity);
+    std::lock_guard lock(loaderMutex);
+    for (auto [it, last] = loaders.equal_range(identity); it != last;) {
+        if (env->IsSameObject(it->second, loader)) return it->second;
+        // A loader collected since its hash was reused by this one.
+        if (collected(env, it->second)) {
+            env->DeleteWeakGlobalRef(it->second);
+            it = loaders.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    if (loaders.size() >= sweepAt) sweepCollectedLoaders(env);
+    return loaders.emplace(identity, env->NewWeakGlobalRef(loader))->second;
+}
+
+jweak canonicalLoaderOf(JNIEnv *env, jvmtiEnv *jvmti, jclass cls) {
+    jobject loader = nullptr;
+    if (jvmti->GetClassLoader(cls, &loader) != JVMTI_ERROR_NONE || !loader) return nullptr;
+    const jweak canonical = canonicalLoader(env, jvmti, loader);
+    env->DeleteLocalRef(loader);
+    return canonical;
+}
+
+void pinCanonicalLoader(const jweak loader) {
+    if (!loader) return;
+    std::lock_guard lock(loaderMutex);
+    pins[loader]++;
+}
+
+void unpinCanonicalLoader(const jweak loader) {
+    if (!loader) return;
+    std::lock_guard lock(loaderMutex);
+    if (const auto it = pins.find(loader); it != pins.end() && --it->second == 0) pins.erase(it);
+}
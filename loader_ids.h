@@ -0,0 +1,23 @@
+#pragma once
+
+#include <jni.h>
+#include <jvmti.h>
+
+// One weak global reference per class loader, handed out to every caller
+// that asks for the same loader. Staged entries compare these by pointer
+// when deduplicating, and the hook compares them to its loader argument
+// with IsSameObject; the bootstrap loader is nullptr.
+//
+// References of collected loaders are deleted when later calls find them,
+// unless pinned. Holders that keep a reference without keeping its loader
+// alive (a class reference does) pin it for as long as they use it.
+jweak canonicalLoader(JNIEnv *env, jvmtiEnv *jvmti, jobject loader);
+
+// The canonical reference for cls's defining loader.
+jweak canonicalLoaderOf(JNIEnv *env, jvmtiEnv *jvmti, jclass cls);
+
+// Pins nest; both accept nullptr. Unpin only once no reader can still be
+// comparing against the reference.
+void pinCanonicalLoader(jweak loader);
+
+void unpinCanonicalLoader(jweak loader);
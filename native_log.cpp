@@ -0,0 +1,204 @@
+#include "native_log.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Bounded multi-producer queue (Vyukov): a record is free for position p when
+// its sequence is p, and holds a committed message when it is p + 1. The
+// single consumer hands it back for position p + capacity.
+static constexpr std::size_t ringCapacity = 4096;
+static_assert(std::has_single_bit(ringCapacity));
+
+struct LogRing {
+    LogRing() {
+        for (std::size_t i = 0; i < ringCapacity; ++i) records[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    alignas(64) std::atomic<std::uint64_t> tail{0};
+    alignas(64) std::atomic<std::int64_t> dropped{0};
+    alignas(64) std::atomic<std::int64_t> logged{0};
+    // Consumer side, guarded by drainMutex.
+    alignas(64) std::uint64_t head = 0;
+    std::int64_t written = 0;
+    LogRecord records[ringCapacity];
+};
+
+static LogRing ring;
+static std::mutex drainMutex;
+static std::mutex drainerMutex;
+// Heap-allocated and deleted only once joined: a static std::thread still
+// joinable at exit would call std::terminate.
+static std::thread *drainer = nullptr;
+// The drainer parks for parkInterval when the ring is empty. Producers never
+// lock: the one that claims a position on a wakeStride boundary unparks it
+// early, at most once per park, so a burst cannot fill the ring.
+static constexpr auto parkInterval = std::chrono::milliseconds(20);
+static constexpr std::uint64_t wakeStride = ringCapacity / 2;
+static std::mutex parkMutex;
+static std::condition_variable unpark;
+static std::atomic<bool> drainerParked{false};
+static bool drainerStopping = false;
+
+void setLogLevel(const LogLevel level) {
+    logThreshold.store(static_cast<jint>(level), std::memory_order_relaxed);
+}
+
+LogRecord *claimLogRecord() {
+    std::uint64_t position = ring.tail.load(std::memory_order_relaxed);
+    while (true) {
+        LogRecord &record = ring.records[position & (ringCapacity - 1)];
+        const std::uint64_t sequence = record.sequence.load(std::memory_order_acquire);
+        const auto lag = static_cast<std::int64_t>(sequence - position);
+        if (lag == 0) {
+            if (ring.tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) return &record;
+        } else if (lag < 0) {
+            ring.dropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        } else {
+            position = ring.tail.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void commitLogRecord(LogRecord *record) {
+    const std::uint64_t sequence = record->sequence.load(std::memory_order_relaxed);
+    ring.logged.fetch_add(1, std::memory_order_relaxed);
+    record->sequence.store(sequence + 1, std::memory_order_release);
+    // A free record's sequence is its position. A lost wakeup only delays
+    // the drain until the park times out.
+    if ((sequence & (wakeStride - 1)) == 0 && drainerParked.exchange(false, std::memory_order_relaxed)) {
+        unpark.notify_one();
+    }
+}
+
+// printf with one conversion of the record's next argument. Length
+// modifiers in the format are replaced by the width the argument was stored
+// with.
+static int formatOne(char *out, const std::size_t outSize, std::string spec, const char conversion,
+                     const LogRecord &record, const std::size_t index) {
+    std::erase_if(spec, [](const char c) { return std::string_view("hlLqjzt").contains(c); });
+    const std::uint64_t raw = record.args[index];
+    switch (conversion) {
+        case 'd':
+        case 'i':
+            return snprintf(out, outSize, (spec + "ll" + conversion).c_str(), static_cast<long long>(raw));
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+            return snprintf(out, outSize, (spec + "ll" + conversion).c_str(), static_cast<unsigned long long>(raw));
+        case 'c':
+            return snprintf(out, outSize, (spec + conversion).c_str(), static_cast<int>(raw));
+        case 's':
+            return snprintf(out, outSize, (spec + conversion).c_str(),
+                            record.kinds[index] == LogArgKind::Text ? record.text + raw : "(?)");
+        case 'p':
+            return snprintf(out, outSize, (spec + conversion).c_str(), reinterpret_cast<void *>(raw));
+        default:
+            return snprintf(out, outSize, (spec + conversion).c_str(), std::bit_cast<double>(raw));
+    }
+}
+
+std::size_t formatLogRecord(const LogRecord &record, char *out, const std::size_t outSize) {
+    std::size_t used = 0;
+    std::size_t next = 0;
+    const auto append = [&](const int n) {
+        if (n > 0) used = std::min(used + static_cast<std::size_t>(n), outSize - 1);
+    };
+    for (const char *p = record.format; *p && used + 1 < outSize; ++p) {
+        if (*p != '%') {
+            out[used++] = *p;
+            continue;
+        }
+        if (p[1] == '%') {
+            out[used++] = '%';
+            ++p;
+            continue;
+        }
+        const char *start = p++;
+        while (*p && !std::string_view("diuxXocspfFeEgGaA").contains(*p)) ++p;
+        if (!*p || next >= record.argCount) {
+            append(snprintf(out + used, outSize - used, "%.*s", static_cast<int>(p - start + (*p != 0)), start));
+            if (!*p) break;
+            continue;
+        }
+        append(formatOne(out + used, outSize - used, std::string(start, p), *p, record, next++));
+    }
+    out[used] = '\0';
+    return used;
+}
+
+// Writes out every committed record; false if there was none.
+static bool drainRecords() {
+    std::lock_guard lock(drainMutex);
+    std::string batch;
+    char line[1024];
+    while (true) {
+        LogRecord &record = ring.records[ring.head & (ringCapacity - 1)];
+        if (record.sequence.load(std::memory_order_acquire) != ring.head + 1) break;
+
+        const std::size_t length = formatLogRecord(record, line, sizeof(line));
+        record.sequence.store(ring.head + ringCapacity, std::memory_order_release);
+        ring.head++;
+        ring.written++;
+        batch.append(line, length);
+        batch.push_back('\n');
+    }
+    if (batch.empty()) return false;
+    fwrite(batch.data(), 1, batch.size(), stdout);
+    fflush(stdout);
+    return true;
+}
+
+static void drain() {
+    std::unique_lock lock(parkMutex);
+    while (!drainerStopping) {
+        lock.unlock();
+        const bool wrote = drainRecords();
+        lock.lock();
+        if (wrote) continue;
+        drainerParked.store(true, std::memory_order_relaxed);
+        unpark.wait_for(lock, parkInterval);
+        drainerParked.store(false, std::memory_order_relaxed);
+    }
+}
+
+void startNativeLog() {
+    std::lock_guard lock(drainerMutex);
+    if (drainer) return;
+    {
+        std::lock_guard parkLock(parkMutex);
+        drainerStopping = false;
+    }
+    // The JVM never unloads a library of the application or system loader,
+    // so JNI_OnUnload alone would leave the thread running into exit.
+    [[maybe_unused]] static const int stopAtExit = std::atexit(stopNativeLog);
+    drainer = new std::thread(drain);
+}
+
+void stopNativeLog() {
+    std::lock_guard lock(drainerMutex);
+    if (drainer) {
+        {
+            std::lock_guard parkLock(parkMutex);
+            drainerStopping = true;
+        }
+        unpark.notify_one();
+        // Joined rather than detached, so no code of this library runs after
+        // JNI_OnUnload or the exit handlers return.
+        drainer->join();
+        delete drainer;
+        drainer = nullptr;
+    }
+    drainRecords();
+}
+
+NativeLogStats nativeLogStats() {
+    std::lock_guard lock(drainMutex);
+    return {ring.logged.load(std::memory_order_relaxed), ring.dropped.load(std::memory_order_relaxed), ring.written};
+}
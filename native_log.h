@@ -0,0 +1,144 @@
+#pragma once
+
+#include <jni.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+
+// Library log, written to stdout by a background drainer. Callers format
+// nothing: a record holds the format string, the raw arguments and a copy of
+// any string arguments, and is pushed into a fixed ring without locking. When
+// the ring is full the record is dropped and counted, so logging never waits
+// for output, even from the ClassFileLoadHook, and never takes a lock. The
+// drainer wakes every 20 ms, or early once half the ring has filled.
+//
+// Formats use printf conversions (flags, width and precision included; no
+// '*'), must have static storage duration, and end without a newline.
+// The values match the LOG_* constants on org.example.Native.
+enum class LogLevel : jint {
+    Debug = 0,
+    Info = 1,
+    Warn = 2,
+    Error = 3,
+    Off = 4,
+};
+
+enum class LogArgKind : std::uint8_t {
+    Signed,
+    Unsigned,
+    Double,
+    Pointer,
+    Text,
+};
+
+struct alignas(64) LogRecord {
+    static constexpr std::size_t maxArgs = 6;
+    static constexpr std::size_t textCapacity = 160;
+
+    std::atomic<std::uint64_t> sequence;
+    const char *format;
+    LogLevel level;
+    std::uint8_t argCount;
+    std::uint8_t textUsed;
+    LogArgKind kinds[maxArgs];
+    // Integers, double bits, pointers, or for Text an offset into text.
+    std::uint64_t args[maxArgs];
+    char text[textCapacity];
+};
+
+static_assert(sizeof(LogRecord) == 256);
+
+inline std::atomic<jint> logThreshold{static_cast<jint>(LogLevel::Info)};
+
+inline bool logEnabled(const LogLevel level) {
+    return static_cast<jint>(level) >= logThreshold.load(std::memory_order_relaxed);
+}
+
+void setLogLevel(LogLevel level);
+
+// Claims a free record, or returns nullptr (and counts a drop) if the ring is
+// full; a claimed record must be passed to commitLogRecord.
+LogRecord *claimLogRecord();
+
+void commitLogRecord(LogRecord *record);
+
+inline void encodeLogText(LogRecord &record, const std::size_t index, std::string_view text) {
+    const std::size_t room = LogRecord::textCapacity - record.textUsed;
+    if (room == 0) {
+        record.kinds[index] = LogArgKind::Pointer;
+        record.args[index] = 0;
+        return;
+    }
+    text = text.substr(0, room - 1);
+    memcpy(record.text + record.textUsed, text.data(), text.size());
+    record.text[record.textUsed + text.size()] = '\0';
+    record.kinds[index] = LogArgKind::Text;
+    record.args[index] = record.textUsed;
+    record.textUsed = static_cast<std::uint8_t>(record.textUsed + text.size() + 1);
+}
+
+template<typename T>
+void encodeLogArg(LogRecord &record, const std::size_t index, const T &value) {
+    if constexpr (std::is_convertible_v<const T &, std::string_view> && !std::is_null_pointer_v<T>) {
+        if constexpr (std::is_pointer_v<std::decay_t<T> >) {
+            encodeLogText(record, index, value ? std::string_view(value) : std::string_view("(null)"));
+        } else {
+            encodeLogText(record, index, std::string_view(value));
+        }
+    } else if constexpr (std::is_floating_point_v<T>) {
+        record.kinds[index] = LogArgKind::Double;
+        record.args[index] = std::bit_cast<std::uint64_t>(static_cast<double>(value));
+    } else if constexpr (std::is_pointer_v<T> || std::is_null_pointer_v<T>) {
+        record.kinds[index] = LogArgKind::Pointer;
+        record.args[index] = reinterpret_cast<std::uintptr_t>(value);
+    } else if constexpr (std::is_signed_v<T> || std::is_enum_v<T>) {
+        record.kinds[index] = LogArgKind::Signed;
+        record.args[index] = static_cast<std::uint64_t>(static_cast<std::int64_t>(value));
+    } else {
+        static_assert(std::is_unsigned_v<T>, "unsupported log argument");
+        record.kinds[index] = LogArgKind::Unsigned;
+        record.args[index] = static_cast<std::uint64_t>(value);
+    }
+}
+
+template<typename... Args>
+void nativeLog(const LogLevel level, const char *format, const Args &... args) {
+    static_assert(sizeof...(Args) <= LogRecord::maxArgs, "too many log arguments");
+    if (!logEnabled(level)) return;
+    LogRecord *record = claimLogRecord();
+    if (!record) return;
+
+    record->format = format;
+    record->level = level;
+    record->argCount = sizeof...(Args);
+    record->textUsed = 0;
+    std::size_t index = 0;
+    (encodeLogArg(*record, index++, args), ...);
+    commitLogRecord(record);
+}
+
+// Starts the drainer thread; records logged before it starts wait in the
+// ring. The first call registers stopNativeLog to run at exit.
+void startNativeLog();
+
+// Stops and joins the drainer thread, then formats and writes every
+// committed record on the calling thread.
+void stopNativeLog();
+
+struct NativeLogStats {
+    std::int64_t logged;
+    std::int64_t dropped;
+    std::int64_t written;
+};
+
+NativeLogStats nativeLogStats();
+
+// Appends record's message, without a trailing newline, to out; out must
+// hold outSize bytes. Returns the length written.
+std::size_t formatLogRecord(const LogRecord &record, char *out, std::size_t outSize);
@@ -0,0 +1,288 @@
+#include "native_metrics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <condition_variable>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+// Log-linear (HDR-style) buckets: values below 16 ticks get a bucket each,
+// every power of two above is split into 16 buckets, so a bucket is at most
+// 1/16 wider than its lower bound. Values past 2^44 ticks share the last.
+static constexpr unsigned subBucketBits = 4;
+static constexpr std::size_t subBucketCount = std::size_t{1} << subBucketBits;
+static constexpr unsigned maxExponent = 39;
+static constexpr std::size_t bucketCount = subBucketCount * (maxExponent + 2);
+
+static std::size_t bucketOf(const std::uint64_t ticks) {
+    if (ticks < subBucketCount) return ticks;
+    const unsigned exponent = std::min<unsigned>(std::bit_width(ticks) - subBucketBits - 1, maxExponent);
+    const std::size_t sub = std::min<std::uint64_t>(ticks >> exponent, 2 * subBucketCount - 1) & (subBucketCount - 1);
+    return subBucketCount * (exponent + 1) + sub;
+}
+
+// Midpoint of the bucket's range.
+static std::uint64_t bucketValue(const std::size_t bucket) {
+    if (bucket < subBucketCount) return bucket;
+    const std::size_t exponent = bucket / subBucketCount - 1;
+    const std::uint64_t low = (subBucketCount + bucket % subBucketCount) << exponent;
+    return low + (std::uint64_t{1} << exponent >> 1);
+}
+
+// Written only by the owning thread, read by anyone: relaxed loads and stores
+// keep it race-free without read-modify-write instructions.
+static void bump(std::atomic<std::uint64_t> &counter, const std::uint64_t by) {
+    counter.store(counter.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+}
+
+struct OpMetrics {
+    std::atomic<std::uint64_t> calls{0};
+    std::atomic<std::uint64_t> hits{0};
+    std::atomic<std::uint64_t> misses{0};
+    std::atomic<std::uint64_t> bytes{0};
+    std::atomic<std::uint64_t> timed{0};
+    std::atomic<std::uint64_t> tickSum{0};
+    std::atomic<std::uint64_t> buckets[bucketCount]{};
+};
+
+// One per thread that has recorded anything. Blocks are never freed: a thread
+// that exits hands its block, counts included, to the next new thread, so the
+// list is bounded by the peak number of recording threads.
+struct ThreadMetrics {
+    std::atomic<bool> inUse{true};
+    ThreadMetrics *next = nullptr;
+    OpMetrics ops[metricOpCount];
+};
+
+static std::atomic<ThreadMetrics *> allThreadMetrics{nullptr};
+
+static ThreadMetrics *adoptThreadMetrics() {
+    for (ThreadMetrics *metrics = allThreadMetrics.load(std::memory_order_acquire); metrics; metrics = metrics->next) {
+        bool free = false;
+        if (!metrics->inUse.load(std::memory_order_relaxed) &&
+            metrics->inUse.compare_exchange_strong(free, true, std::memory_order_acquire)) {
+            return metrics;
+        }
+    }
+    auto *metrics = new ThreadMetrics;
+    metrics->next = allThreadMetrics.load(std::memory_order_relaxed);
+    while (!allThreadMetrics.compare_exchange_weak(metrics->next, metrics, std::memory_order_release,
+                                                   std::memory_order_relaxed)) {
+    }
+    return metrics;
+}
+
+struct ThreadMetricsHandle {
+    ThreadMetrics *metrics = adoptThreadMetrics();
+
+    ~ThreadMetricsHandle() { metrics->inUse.store(false, std::memory_order_release); }
+};
+
+static OpMetrics &threadOpMetrics(const MetricOp op) {
+    thread_local ThreadMetricsHandle handle;
+    return handle.metrics->ops[static_cast<std::size_t>(op)];
+}
+
+static constexpr std::size_t failureCodeCount = 128;
+static std::atomic<std::int64_t> failureCounts[metricOpCount][failureCodeCount]{};
+
+void recordMetric(const MetricOp op, const std::uint64_t hits, const std::uint64_t misses, const std::uint64_t bytes) {
+    OpMetrics &metrics = threadOpMetrics(op);
+    bump(metrics.calls, 1);
+    bump(metrics.hits, hits);
+    bump(metrics.misses, misses);
+    bump(metrics.bytes, bytes);
+}
+
+void recordHookFilterMiss() {
+    // Trivially constructed, unlike the handle threadOpMetrics sets up.
+    thread_local std::uint32_t unflushed = 0;
+    if (++unflushed < hookFilterMissBatch) return;
+    unflushed = 0;
+    OpMetrics &metrics = threadOpMetrics(MetricOp::ClassLoadHook);
+    bump(metrics.calls, hookFilterMissBatch);
+    bump(metrics.misses, hookFilterMissBatch);
+}
+
+void recordTimedMetric(const MetricOp op, const std::uint64_t hits, const std::uint64_t misses,
+                       const std::uint64_t bytes, const std::uint64_t startedTicks) {
+    const std::uint64_t ticks = metricTicks() - startedTicks;
+    OpMetrics &metrics = threadOpMetrics(op);
+    bump(metrics.calls, 1);
+    bump(metrics.hits, hits);
+    bump(metrics.misses, misses);
+    bump(metrics.bytes, bytes);
+    bump(metrics.timed, 1);
+    bump(metrics.tickSum, ticks);
+    bump(metrics.buckets[bucketOf(ticks)], 1);
+}
+
+void recordMetricFailure(const MetricOp op, const jvmtiError err) {
+    const std::size_t code = std::min<std::size_t>(static_cast<std::size_t>(err), failureCodeCount - 1);
+    failureCounts[static_cast<std::size_t>(op)][code].fetch_add(1, std::memory_order_relaxed);
+}
+
+void recordApplyMetric(const MetricOp op, const jvmtiError err, const std::size_t classCount,
+                       const std::size_t bytes, const std::uint64_t startedTicks) {
+    if (err != JVMTI_ERROR_NONE) recordMetricFailure(op, err);
+    const bool applied = err == JVMTI_ERROR_NONE;
+    recordTimedMetric(op, applied ? classCount : 0, applied ? 0 : classCount, bytes, startedTicks);
+}
+
+// Reference point for converting ticks to nanoseconds, taken at load time.
+static const std::uint64_t originTicks = metricTicks();
+static const auto originTime = std::chrono::steady_clock::now();
+
+static double nanosPerTick() {
+#if defined(__x86_64__) || defined(_M_X64)
+    // The ratio is only trusted over at least a millisecond.
+    while (std::chrono::steady_clock::now() - originTime < std::chrono::milliseconds(1)) std::this_thread::yield();
+    const auto elapsed = std::chrono::steady_clock::now() - originTime;
+    const std::uint64_t ticks = metricTicks() - originTicks;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / static_cast<double>(ticks);
+#else
+    return 1.0;
+#endif
+}
+
+MetricsSnapshot metricsSnapshot() {
+    const double scale = nanosPerTick();
+    MetricsSnapshot snapshot{};
+    for (std::size_t op = 0; op < metricOpCount; ++op) {
+        std::uint64_t calls = 0, hits = 0, misses = 0, bytes = 0, timed = 0, tickSum = 0;
+        std::vector<std::uint64_t> buckets(bucketCount);
+        for (ThreadMetrics *thread = allThreadMetrics.load(std::memory_order_acquire); thread; thread = thread->next) {
+            const OpMetrics &metrics = thread->ops[op];
+            calls += metrics.calls.load(std::memory_order_relaxed);
+            hits += metrics.hits.load(std::memory_order_relaxed);
+            misses += metrics.misses.load(std::memory_order_relaxed);
+            bytes += metrics.bytes.load(std::memory_order_relaxed);
+            timed += metrics.timed.load(std::memory_order_relaxed);
+            tickSum += metrics.tickSum.load(std::memory_order_relaxed);
+            for (std::size_t b = 0; b < bucketCount; ++b) buckets[b] += metrics.buckets[b].load(std::memory_order_relaxed);
+        }
+
+        std::int64_t failures = 0;
+        for (jint code = 0; code < static_cast<jint>(failureCodeCount); ++code) {
+            const std::int64_t count = failureCounts[op][code].load(std::memory_order_relaxed);
+            if (count == 0) continue;
+            failures += count;
+            snapshot.failures.push_back({static_cast<MetricOp>(op), code, count});
+        }
+
+        // Counters are read one after another while threads keep recording,
+        // so the bucket total rather than timed is the percentile base.
+        std::uint64_t recorded = 0;
+        for (const std::uint64_t count: buckets) recorded += count;
+        const auto percentile = [&](const double q) -> std::int64_t {
+            if (recorded == 0) return 0;
+            const auto rank = static_cast<std::uint64_t>(q * static_cast<double>(recorded - 1));
+            std::uint64_t seen = 0;
+            for (std::size_t b = 0; b < bucketCount; ++b) {
+                seen += buckets[b];
+                if (seen > rank) return static_cast<std::int64_t>(static_cast<double>(bucketValue(b)) * scale);
+            }
+            return 0;
+        };
+        const auto maxBucket = std::find_if(buckets.rbegin(), buckets.rend(), [](const auto count) { return count; });
+        const std::int64_t maxNanos = maxBucket == buckets.rend()
+                                          ? 0
+                                          : static_cast<std::int64_t>(
+                                              static_cast<double>(bucketValue(buckets.rend() - maxBucket - 1)) * scale);
+
+        std::int64_t *fields = snapshot.fields[op];
+        fields[0] = static_cast<std::int64_t>(calls);
+        fields[1] = static_cast<std::int64_t>(hits);
+        fields[2] = static_cast<std::int64_t>(misses);
+        fields[3] = static_cast<std::int64_t>(bytes);
+        fields[4] = failures;
+        fields[5] = static_cast<std::int64_t>(timed);
+        fields[6] = timed ? static_cast<std::int64_t>(static_cast<double>(tickSum) * scale / timed) : 0;
+        fields[7] = percentile(0.5);
+        fields[8] = percentile(0.9);
+        fields[9] = percentile(0.99);
+        fields[10] = percentile(0.999);
+        fields[11] = maxNanos;
+    }
+    return snapshot;
+}
+
+static constexpr const char *opNames[metricOpCount] = {"class_load_hook", "redefine", "retransform", "access_class"};
+
+std::string formatMetrics(const MetricsSnapshot &snapshot) {
+    static constexpr const char *fieldNames[metricFieldCount] = {
+        "calls", "hits", "misses", "bytes", "failures", "timed", "mean_ns", "p50_ns", "p90_ns", "p99_ns",
+        "p999_ns", "max_ns"
+    };
+    std::string text = "# JNILibrary metrics at " + std::to_string(std::time(nullptr)) + "\n";
+    char line[96];
+    for (std::size_t op = 0; op < metricOpCount; ++op) {
+        for (std::size_t field = 0; field < metricFieldCount; ++field) {
+            snprintf(line, sizeof(line), "%s.%s %lld\n", opNames[op], fieldNames[field],
+                     static_cast<long long>(snapshot.fields[op][field]));
+            text += line;
+        }
+    }
+    for (const MetricFailureCount &failure: snapshot.failures) {
+        snprintf(line, sizeof(line), "%s.error.%d %lld\n", opNames[static_cast<std::size_t>(failure.op)],
+                 failure.error, static_cast<long long>(failure.count));
+        text += line;
+    }
+    return text;
+}
+
+static std::mutex exporterMutex;
+static std::condition_variable exporterChanged;
+static std::uint64_t exporterGeneration = 0;
+// Serializes replacing the exporter, which joins the previous one. Held on
+// the heap so that one still running at exit is not a joinable static.
+static std::mutex exporterControlMutex;
+static std::thread *exporter = nullptr;
+
+// Writes beside path and renames over it, so a reader never sees a partial
+// file.
+static void exportMetrics(const std::filesystem::path &path) {
+    std::filesystem::path temporary = path;
+    temporary += ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::trunc);
+        out << formatMetrics(metricsSnapshot());
+        if (!out) return;
+    }
+    std::error_code ignored;
+    std::filesystem::rename(temporary, path, ignored);
+}
+
+void setMetricsExporter(std::string path, const std::chrono::milliseconds interval) {
+    std::lock_guard control(exporterControlMutex);
+    std::uint64_t generation;
+    {
+        std::lock_guard lock(exporterMutex);
+        generation = ++exporterGeneration;
+        exporterChanged.notify_all();
+    }
+    if (exporter) {
+        exporter->join();
+        delete exporter;
+        exporter = nullptr;
+    }
+    if (path.empty() || interval.count() <= 0) return;
+
+    exporter = new std::thread([generation, path = std::filesystem::path(std::move(path)), interval] {
+        std::unique_lock lock(exporterMutex);
+        while (!exporterChanged.wait_for(lock, interval, [&] { return exporterGeneration != generation; })) {
+            lock.unlock();
+            exportMetrics(path);
+            lock.lock();
+        }
+    });
+}
+
+void stopMetricsExporter() {
+    setMetricsExporter({}, std::chrono::milliseconds{0});
+}
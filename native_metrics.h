@@ -0,0 +1,92 @@
+#pragma once
+
+#include <jvmti.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#elif defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+// Operations the library measures. The values index the blocks of
+// getStats(), in this order.
+enum class MetricOp {
+    ClassLoadHook,
+    Redefine,
+    Retransform,
+    AccessClass,
+};
+
+inline constexpr std::size_t metricOpCount = 4;
+
+// Cheapest monotonic timestamp available: the TSC on x86-64 (invariant on
+// every CPU HotSpot still supports), steady_clock nanoseconds elsewhere.
+// Converted to nanoseconds only when stats are read.
+inline std::uint64_t metricTicks() {
+#if defined(__x86_64__) || defined(_M_X64)
+    return __rdtsc();
+#else
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+// Counts one call of op on the calling thread: hits and misses are items
+// found or applied and items not, bytes the class file bytes moved. Each
+// thread owns its counters and histograms, so recording is a few plain
+// stores with no atomic read-modify-write and no lock.
+void recordMetric(MetricOp op, std::uint64_t hits, std::uint64_t misses, std::uint64_t bytes);
+
+// Counts a ClassFileLoadHook call the staging filters rejected, as one call
+// and one miss. The hot path is an increment of a plain thread-local counter
+// that is added to the stats every hookFilterMissBatch calls, so the stats
+// lag by fewer than that many per thread, and a thread that exits takes its
+// partial batch with it.
+inline constexpr std::uint32_t hookFilterMissBatch = 256;
+
+void recordHookFilterMiss();
+
+// Like recordMetric, and adds the call's latency, in metricTicks() since
+// startedTicks, to op's histogram.
+void recordTimedMetric(MetricOp op, std::uint64_t hits, std::uint64_t misses, std::uint64_t bytes,
+                       std::uint64_t startedTicks);
+
+// Counts a failed call of op under its error code.
+void recordMetricFailure(MetricOp op, jvmtiError err);
+
+// Records one timed redefine or retransform of classCount classes: all of
+// them hits on success, all misses and a failure on error.
+void recordApplyMetric(MetricOp op, jvmtiError err, std::size_t classCount, std::size_t bytes,
+                       std::uint64_t startedTicks);
+
+// Per op, metricFieldCount values: calls, hits, misses, bytes, failures,
+// timed calls, then mean, p50, p90, p99, p99.9 and max latency in ns.
+inline constexpr std::size_t metricFieldCount = 12;
+
+struct MetricFailureCount {
+    MetricOp op;
+    jint error;
+    std::int64_t count;
+};
+
+struct MetricsSnapshot {
+    std::int64_t fields[metricOpCount][metricFieldCount];
+    std::vector<MetricFailureCount> failures;
+};
+
+MetricsSnapshot metricsSnapshot();
+
+std::string formatMetrics(const MetricsSnapshot &snapshot);
+
+// Rewrites path with formatMetrics() every interval from a background
+// thread, replacing the previous exporter, which is joined first; a zero
+// interval or empty path stops exporting.
+void setMetricsExporter(std::string path, std::chrono::milliseconds interval);
+
+void stopMetricsExporter();
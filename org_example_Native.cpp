@@ -2,12 +2,45 @@
 #include <jni.h>
 #include <string>
 #include <vector>
-#include <unordered_map>
-#include <mutex>
-#include <cstdio>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <cstring>
-#include <cstring>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <span>
+#include <thread>
+#include <utility>
+
+#include "capabilities.h"
+#include "class_cache.h"
+#include "class_names.h"
+#include "content_hash.h"
+#include "error_names.h"
+#include "event_recorder.h"
+#include "first_load.h"
+#include "installed_hashes.h"
+#include "loader_ids.h"
+#include "loaded_classes.h"
+#include "native_log.h"
+#include "native_metrics.h"
+#include "org_example_Native.h"
+#include "pause_budget.h"
+#include "redefine_worker.h"
+#include "staged_classes.h"
+#include "staging.h"
+
+static_assert(static_cast<jint>(CapabilityProfile::RedefineOnly) == org_example_Native_PROFILE_REDEFINE_ONLY);
+static_assert(static_cast<jint>(CapabilityProfile::Retransform) == org_example_Native_PROFILE_RETRANSFORM);
+static_assert(static_cast<jint>(CapabilityProfile::Profiling) == org_example_Native_PROFILE_PROFILING);
+static_assert(static_cast<jint>(CapabilityProfile::HeapAnalysis) == org_example_Native_PROFILE_HEAP_ANALYSIS);
+static_assert(static_cast<jint>(StagedLifecycle::OneShot) == org_example_Native_LIFECYCLE_ONE_SHOT);
+static_assert(static_cast<jint>(StagedLifecycle::Sticky) == org_example_Native_LIFECYCLE_STICKY);
+static_assert(static_cast<jint>(LogLevel::Debug) == org_example_Native_LOG_DEBUG);
+static_assert(static_cast<jint>(LogLevel::Off) == org_example_Native_LOG_OFF);
 
 std::string toCppString(JNIEnv *env, jstring str) {
     const char *utf = env->GetStringUTFChars(str, nullptr);
@@ -16,224 +49,1176 @@ std::string toCppString(JNIEnv *env, jstring str) {
     return name;
 }
 
-const char *getErrorName(const jvmtiError err) {
-    switch (err) {
-        case JVMTI_ERROR_NONE: return "JVMTI_ERROR_NONE";
-        case JVMTI_ERROR_INVALID_THREAD: return "JVMTI_ERROR_INVALID_THREAD";
-        case JVMTI_ERROR_INVALID_THREAD_GROUP: return "JVMTI_ERROR_INVALID_THREAD_GROUP";
-        case JVMTI_ERROR_INVALID_PRIORITY: return "JVMTI_ERROR_INVALID_PRIORITY";
-        case JVMTI_ERROR_THREAD_NOT_SUSPENDED: return "JVMTI_ERROR_THREAD_NOT_SUSPENDED";
-        case JVMTI_ERROR_THREAD_SUSPENDED: return "JVMTI_ERROR_THREAD_SUSPENDED";
-        case JVMTI_ERROR_THREAD_NOT_ALIVE: return "JVMTI_ERROR_THREAD_NOT_ALIVE";
-        case JVMTI_ERROR_INVALID_OBJECT: return "JVMTI_ERROR_INVALID_OBJECT";
-        case JVMTI_ERROR_INVALID_CLASS: return "JVMTI_ERROR_INVALID_CLASS";
-        case JVMTI_ERROR_CLASS_NOT_PREPARED: return "JVMTI_ERROR_CLASS_NOT_PREPARED";
-        case JVMTI_ERROR_INVALID_METHODID: return "JVMTI_ERROR_INVALID_METHODID";
-        case JVMTI_ERROR_INVALID_LOCATION: return "JVMTI_ERROR_INVALID_LOCATION";
-        case JVMTI_ERROR_INVALID_FIELDID: return "JVMTI_ERROR_INVALID_FIELDID";
-        case JVMTI_ERROR_INVALID_MODULE: return "JVMTI_ERROR_INVALID_MODULE";
-        case JVMTI_ERROR_NO_MORE_FRAMES: return "JVMTI_ERROR_NO_MORE_FRAMES";
-        case JVMTI_ERROR_OPAQUE_FRAME: return "JVMTI_ERROR_OPAQUE_FRAME";
-        case JVMTI_ERROR_TYPE_MISMATCH: return "JVMTI_ERROR_TYPE_MISMATCH";
-        case JVMTI_ERROR_INVALID_SLOT: return "JVMTI_ERROR_INVALID_SLOT";
-        case JVMTI_ERROR_DUPLICATE: return "JVMTI_ERROR_DUPLICATE";
-        case JVMTI_ERROR_NOT_FOUND: return "JVMTI_ERROR_NOT_FOUND";
-        case JVMTI_ERROR_INVALID_MONITOR: return "JVMTI_ERROR_INVALID_MONITOR";
-        case JVMTI_ERROR_NOT_MONITOR_OWNER: return "JVMTI_ERROR_NOT_MONITOR_OWNER";
-        case JVMTI_ERROR_INTERRUPT: return "JVMTI_ERROR_INTERRUPT";
-        case JVMTI_ERROR_INVALID_CLASS_FORMAT: return "JVMTI_ERROR_INVALID_CLASS_FORMAT";
-        case JVMTI_ERROR_CIRCULAR_CLASS_DEFINITION: return "JVMTI_ERROR_CIRCULAR_CLASS_DEFINITION";
-        case JVMTI_ERROR_FAILS_VERIFICATION: return "JVMTI_ERROR_FAILS_VERIFICATION";
-        case JVMTI_ERROR_UNSUPPORTED_REDEFINITION_METHOD_ADDED: return
-                    "JVMTI_ERROR_UNSUPPORTED_REDEFINITION_METHOD_ADDED";
-        case JVMTI_ERROR_UNSUPPORTED_REDEFINITION_SCHEMA_CHANGED: return
-                    "JVMTI_ERROR_UNSUPPORTED_REDEFINITION_SCHEMA_CHANGED";
-        case JVMTI_ERROR_INVALID_TYPESTATE: return "JVMTI_ERROR_INVALID_TYPESTATE";
-        case JVMTI_ERROR_UNSUPPORTED_REDEFINITION_HIERARCHY_CHANGED: return
-                    "JVMTI_ERROR_UNSUPPORTED_REDEFINITION_HIERARCHY_CHANGED";
-        case JVMTI_ERROR_UNSUPPORTED_REDEFINITION_METHOD_DELETED: return
-                    "JVMTI_ERROR_UNSUPPORTED_REDEFINITION_METHOD_DELETED";
-        case JVMTI_ERROR_UNSUPPORTED_VERSION: return "JVMTI_ERROR_UNSUPPORTED_VERSION";
-        case JVMTI_ERROR_NAMES_DONT_MATCH: return "JVMTI_ERROR_NAMES_DONT_MATCH";
-        case JVMTI_ERROR_UNSUPPORTED_REDEFINITION_CLASS_MODIFIERS_CHANGED: return
-                    "JVMTI_ERROR_UNSUPPORTED_REDEFINITION_CLASS_MODIFIERS_CHANGED";
-        case JVMTI_ERROR_UNSUPPORTED_REDEFINITION_METHOD_MODIFIERS_CHANGED: return
-                    "JVMTI_ERROR_UNSUPPORTED_REDEFINITION_METHOD_MODIFIERS_CHANGED";
-        case JVMTI_ERROR_UNSUPPORTED_REDEFINITION_CLASS_ATTRIBUTE_CHANGED: return
-                    "JVMTI_ERROR_UNSUPPORTED_REDEFINITION_CLASS_ATTRIBUTE_CHANGED";
-        case JVMTI_ERROR_UNMODIFIABLE_CLASS: return "JVMTI_ERROR_UNMODIFIABLE_CLASS";
-        case JVMTI_ERROR_UNMODIFIABLE_MODULE: return "JVMTI_ERROR_UNMODIFIABLE_MODULE";
-        case JVMTI_ERROR_NOT_AVAILABLE: return "JVMTI_ERROR_NOT_AVAILABLE";
-        case JVMTI_ERROR_MUST_POSSESS_CAPABILITY: return "JVMTI_ERROR_MUST_POSSESS_CAPABILITY";
-        case JVMTI_ERROR_NULL_POINTER: return "JVMTI_ERROR_NULL_POINTER";
-        case JVMTI_ERROR_ABSENT_INFORMATION: return "JVMTI_ERROR_ABSENT_INFORMATION";
-        case JVMTI_ERROR_INVALID_EVENT_TYPE: return "JVMTI_ERROR_INVALID_EVENT_TYPE";
-        case JVMTI_ERROR_ILLEGAL_ARGUMENT: return "JVMTI_ERROR_ILLEGAL_ARGUMENT";
-        case JVMTI_ERROR_NATIVE_METHOD: return "JVMTI_ERROR_NATIVE_METHOD";
-        case JVMTI_ERROR_CLASS_LOADER_UNSUPPORTED: return "JVMTI_ERROR_CLASS_LOADER_UNSUPPORTED";
-        case JVMTI_ERROR_OUT_OF_MEMORY: return "JVMTI_ERROR_OUT_OF_MEMORY";
-        case JVMTI_ERROR_ACCESS_DENIED: return "JVMTI_ERROR_ACCESS_DENIED";
-        case JVMTI_ERROR_WRONG_PHASE: return "JVMTI_ERROR_WRONG_PHASE";
-        case JVMTI_ERROR_INTERNAL: return "JVMTI_ERROR_INTERNAL";
-        case JVMTI_ERROR_UNATTACHED_THREAD: return "JVMTI_ERROR_UNATTACHED_THREAD";
-        case JVMTI_ERROR_INVALID_ENVIRONMENT: return "JVMTI_ERROR_INVALID_ENVIRONMENT";
-        default: return "Unknown JVMTI error";
-    }
-}
-
-static std::pmr::unordered_map<std::string, std::vector<unsigned char> > classBytecodeMap;
-static std::mutex mapMutex;
+// Reads a binary name ("java.lang.String") into out as an internal name,
+// reusing out's storage across calls.
+static void readInternalName(JNIEnv *env, jstring className, std::string &out) {
+    const jsize utfLength = env->GetStringUTFLength(className);
+    out.resize(utfLength + 1);
+    env->GetStringUTFRegion(className, 0, env->GetStringLength(className), out.data());
+    out.resize(utfLength);
+    std::ranges::replace(out, '.', '/');
+}
+
 static jvmtiEnv *jvmti = nullptr;
 
-static void JNICALL onClassLoad(jvmtiEnv *, JNIEnv *, jclass, jobject, const char *name,
+// Global references and IDs resolved once in JNI_OnLoad.
+static jclass classClass;
+static jclass optionalClass;
+static jclass stringClass;
+static jmethodID ofMethod;
+static jmethodID emptyMethod;
+
+static jclass globalClass(JNIEnv *env, const char *name) {
+    jclass local = env->FindClass(name);
+    if (!local) return nullptr;
+    auto global = static_cast<jclass>(env->NewGlobalRef(local));
+    env->DeleteLocalRef(local);
+    return global;
+}
+
+static bool cacheJavaIds(JNIEnv *env) {
+    classClass = globalClass(env, "java/lang/Class");
+    optionalClass = globalClass(env, "java/util/Optional");
+    stringClass = globalClass(env, "java/lang/String");
+    if (!classClass || !optionalClass || !stringClass) return false;
+    ofMethod = env->GetStaticMethodID(optionalClass, "of", "(Ljava/lang/Object;)Ljava/util/Optional;");
+    emptyMethod = env->GetStaticMethodID(optionalClass, "empty", "()Ljava/util/Optional;");
+    return optionalClass && ofMethod && emptyMethod;
+}
+
+static void scheduleFirstLoadSweep();
+
+// Runs on whichever thread loads or retransforms the class, virtual threads
+// included, so nothing here may block: the staging channels are read through
+// wait-free guards and messages go through the log ring, never to stdio,
+// whose lock could stall a carrier thread behind an unrelated writer.
+static void JNICALL onClassLoad(jvmtiEnv *hookEnv, JNIEnv *jni, jclass redefined, jobject loader, const char *name,
                                 jobject, jint, const unsigned char *, jint *out_len, unsigned char **out_data) {
-    std::lock_guard lock(mapMutex);
-    auto it = classBytecodeMap.find(name);
-    if (it == classBytecodeMap.end()) return;
+    if (!name) return;
+    StagingKey key;
+    const bool batchMayMatch = stagingMayContain(name, key);
+    const bool stickyMayMatch = redefined && stagingMayContain(name, key, StagingChannel::Sticky);
+    const bool firstLoadMayMatch = !redefined && stagingMayContain(name, key, StagingChannel::FirstLoad);
+    if (!batchMayMatch && !stickyMayMatch && !firstLoadMayMatch) {
+        recordHookFilterMiss();
+        return;
+    }
+
+    // Only hits are timed. A rejection by the filters costs the probes and a
+    // thread-local increment; one that gets past them is counted untimed.
+    const std::uint64_t started = metricTicks();
+    const StagingReadGuard guard;
+    const StagedEntry *staged = nullptr;
+    StagingChannel channel = StagingChannel::Retransform;
+    if (const StagingSnapshot *batch = guard.snapshot(); batchMayMatch && batch) {
+        staged = batch->match(jni, key, loader);
+        if (staged) batch->recordHit(*staged);
+    }
+    if (const StagingSnapshot *sticky = guard.snapshot(StagingChannel::Sticky); !staged && stickyMayMatch && sticky) {
+        staged = sticky->match(jni, key, loader);
+        if (staged) sticky->recordHit(*staged);
+        channel = StagingChannel::Sticky;
+    }
+    if (const StagingSnapshot *firstLoad = guard.snapshot(StagingChannel::FirstLoad);
+        !staged && firstLoadMayMatch && firstLoad) {
+        staged = firstLoad->match(jni, key, loader);
+        if (staged && !firstLoad->recordHit(*staged)) staged = nullptr;
+        if (staged && firstLoadDefinitionFired()) scheduleFirstLoadSweep();
+        channel = StagingChannel::FirstLoad;
+    }
+    if (!staged) {
+        recordMetric(MetricOp::ClassLoadHook, 0, 1, 0);
+        return;
+    }
 
-    const auto &data = it->second;
+    // The VM frees new_class_data with Deallocate, so it must come from Allocate.
+    const auto data = staged->bytes();
+    unsigned char *copy = nullptr;
+    if (const jvmtiError err = hookEnv->Allocate(static_cast<jlong>(data.size()), &copy); err != JVMTI_ERROR_NONE) {
+        recordMetricFailure(MetricOp::ClassLoadHook, err);
+        recordMetric(MetricOp::ClassLoadHook, 0, 1, 0);
+        return;
+    }
+    memcpy(copy, data.data(), data.size());
     *out_len = static_cast<jint>(data.size());
-    *out_data = static_cast<unsigned char *>(malloc(data.size()));
-    memcpy(*out_data, data.data(), data.size());
-    printf("[+] Replaced class: %s (%d bytes)\n", name, *out_len);
+    *out_data = copy;
+    recordTimedMetric(MetricOp::ClassLoadHook, 1, 0, data.size(), started);
+    recordEvent({
+        .type = EventType::HookHit, .flags = static_cast<std::uint16_t>(channel), .bytes = data.size(), .text = name
+    });
+    nativeLog(LogLevel::Info, "[+] Replaced class: %s (%d bytes)", name, *out_len);
 }
 
-static bool initJvmti(JNIEnv *env) {
-    if (jvmti) return true;
+static void JNICALL onClassPrepare(jvmtiEnv *, JNIEnv *env, jthread, jclass cls) {
+    loadedClassPrepared(env, cls);
+}
 
-    JavaVM *jvm = nullptr;
-    if (env->GetJavaVM(&jvm) != JNI_OK || !jvm ||
-        jvm->GetEnv(reinterpret_cast<void **>(&jvmti), JVMTI_VERSION_1_2) != JNI_OK || !jvmti) {
-        printf("[-] Failed to obtain JVMTI\n");
-        return false;
-    }
+static void JNICALL onObjectFree(jvmtiEnv *, const jlong tag) {
+    loadedClassFreed(tag);
+}
 
-    jvmtiCapabilities caps{};
-    if (jvmti->GetPotentialCapabilities(&caps) != JVMTI_ERROR_NONE ||
-        jvmti->AddCapabilities(&caps) != JVMTI_ERROR_NONE) {
-        printf("[-] Failed to add capabilities\n");
+// Called once from JNI_OnLoad, before any native can run.
+static bool initJvmti(JavaVM *jvm) {
+    const jint version = obtainJvmti(jvm, &jvmti);
+    if (!version) {
+        nativeLog(LogLevel::Error, "[-] Failed to obtain JVMTI");
         return false;
     }
+    // Class loads on virtual threads then reach the hook like any other, and
+    // a retransform issued from a virtual thread can arm it for that thread.
+    const bool virtualThreads = acquireVirtualThreadSupport(jvmti);
+    nativeLog(LogLevel::Info, "[*] JVMTI %d.%d, virtual threads %s", version >> 16 & 0x0FFF, version >> 8 & 0xFF,
+              virtualThreads ? "supported" : "unsupported");
 
+    // Every event the library uses has its callback installed here once;
+    // features turn delivery on and off with SetEventNotificationMode.
     jvmtiEventCallbacks cb{};
     cb.ClassFileLoadHook = onClassLoad;
+    cb.ClassPrepare = onClassPrepare;
+    cb.ObjectFree = onObjectFree;
     jvmti->SetEventCallbacks(&cb, sizeof(cb));
-    jvmti->SetEventNotificationMode(JVMTI_ENABLE, JVMTI_EVENT_CLASS_FILE_LOAD_HOOK, nullptr);
     return true;
 }
 
-static std::string getInternalName(JNIEnv *env, jobject cls) {
-    jclass clsCls = env->FindClass("java/lang/Class");
-    jmethodID mid = env->GetMethodID(clsCls, "getName", "()Ljava/lang/String;");
-    jstring jname = (jstring) env->CallObjectMethod(cls, mid);
-    std::string name = toCppString(env, jname);
-    std::ranges::replace(name, '.', '/');
-    env->DeleteLocalRef(jname);
-    return name;
+static LogLevel outcomeLevel(const jvmtiError err) {
+    return err == JVMTI_ERROR_NONE ? LogLevel::Info : LogLevel::Error;
 }
 
-extern "C" JNIEXPORT void JNICALL
-Java_org_example_Native_retransformClass(JNIEnv *env, jclass, jobjectArray classes, jobjectArray bytesArray) {
-    if (!initJvmti(env)) return;
+static bool requireProfile(const CapabilityProfile profile) {
+    const jvmtiError err = acquireCapabilityProfile(jvmti, profile);
+    if (err == JVMTI_ERROR_NONE) return true;
+    nativeLog(LogLevel::Error, "[-] Failed to add capabilities: %s", getErrorName(err));
+    return false;
+}
 
-    const jsize count = env->GetArrayLength(classes);
-    if (count != env->GetArrayLength(bytesArray)) {
-        printf("[-] Array length mismatch\n");
-        return;
+// Global ClassFileLoadHook delivery is shared between retransform batches
+// that could not get thread scope, pending first-load definitions and sticky
+// staged classes.
+static std::mutex globalHookMutex;
+static int globalHookUsers = 0;
+
+static void retainGlobalClassFileLoadHook() {
+    std::lock_guard lock(globalHookMutex);
+    if (globalHookUsers++ == 0) {
+        jvmti->SetEventNotificationMode(JVMTI_ENABLE, JVMTI_EVENT_CLASS_FILE_LOAD_HOOK, nullptr);
+    }
+}
+
+static void releaseGlobalClassFileLoadHook() {
+    std::lock_guard lock(globalHookMutex);
+    if (--globalHookUsers == 0) {
+        jvmti->SetEventNotificationMode(JVMTI_DISABLE, JVMTI_EVENT_CLASS_FILE_LOAD_HOOK, nullptr);
+    }
+}
+
+// One feature's share of global hook delivery, held while it has work.
+class GlobalHookHold {
+public:
+    // pending() is read under the hold's lock, so of two racing syncs the
+    // one that applies last also saw the later count.
+    void sync(std::size_t (*pending)()) {
+        std::lock_guard lock(mutex_);
+        const bool needed = pending() != 0;
+        if (needed && !held_) retainGlobalClassFileLoadHook();
+        if (!needed && held_) releaseGlobalClassFileLoadHook();
+        held_ = needed;
+    }
+
+private:
+    std::mutex mutex_;
+    bool held_ = false;
+};
+
+static GlobalHookHold firstLoadHook;
+static GlobalHookHold stickyHook;
+
+static void syncStickyHook() {
+    stickyHook.sync(stickyClassCount);
+}
+
+// ClassFileLoadHook is only delivered while a staged batch is being applied,
+// and only to the retransforming thread unless the VM refuses thread scope.
+class ScopedClassFileLoadHook {
+public:
+    explicit ScopedClassFileLoadHook(JNIEnv *env) : env_(env) {
+        if (jvmti->GetCurrentThread(&thread_) != JVMTI_ERROR_NONE) thread_ = nullptr;
+        if (thread_ && jvmti->SetEventNotificationMode(JVMTI_ENABLE, JVMTI_EVENT_CLASS_FILE_LOAD_HOOK, thread_) ==
+            JVMTI_ERROR_NONE) {
+            return;
+        }
+        if (thread_) env_->DeleteLocalRef(thread_);
+        thread_ = nullptr;
+        retainGlobalClassFileLoadHook();
+    }
+
+    ~ScopedClassFileLoadHook() {
+        if (!thread_) {
+            releaseGlobalClassFileLoadHook();
+            return;
+        }
+        jvmti->SetEventNotificationMode(JVMTI_DISABLE, JVMTI_EVENT_CLASS_FILE_LOAD_HOOK, thread_);
+        env_->DeleteLocalRef(thread_);
+    }
+
+    ScopedClassFileLoadHook(const ScopedClassFileLoadHook &) = delete;
+    ScopedClassFileLoadHook &operator=(const ScopedClassFileLoadHook &) = delete;
+
+private:
+    JNIEnv *env_;
+    jthread thread_ = nullptr;
+};
+
+static std::mutex retransformMutex;
+
+// One copy straight out of the Java heap into storage the staging set keeps.
+static std::shared_ptr<const std::vector<unsigned char> > copyJavaBytes(JNIEnv *env, jbyteArray arr) {
+    auto owned = std::make_shared<std::vector<unsigned char> >(env->GetArrayLength(arr));
+    env->GetByteArrayRegion(arr, 0, static_cast<jsize>(owned->size()), reinterpret_cast<jbyte *>(owned->data()));
+    env->DeleteLocalRef(arr);
+    return owned;
+}
+
+// One copy straight out of the Java heap into the batch arena.
+static std::span<const unsigned char> copyIntoSnapshot(JNIEnv *env, StagingSnapshot &next, jbyteArray arr) {
+    const std::span<unsigned char> bytes = next.allocateBytes(env->GetArrayLength(arr));
+    env->GetByteArrayRegion(arr, 0, static_cast<jsize>(bytes.size()), reinterpret_cast<jbyte *>(bytes.data()));
+    env->DeleteLocalRef(arr);
+    return bytes;
+}
+
+// Staging-set key for cls: its name and defining loader, or its name alone
+// when staged for any loader. Empty name if the signature cannot be read.
+static StagedKey stagedKeyOf(JNIEnv *env, jclass cls, const bool anyLoader) {
+    const std::string_view name = internalClassName(jvmti, cls);
+    if (name.empty() || anyLoader) return {name, nullptr, anyLoader};
+    return {name, canonicalLoaderOf(env, jvmti, cls), false};
+}
+
+// Adds cls to the batch; false, leaving toRetransform unchanged, if its name
+// cannot be read.
+static bool stageForRetransform(JNIEnv *env, StagingSnapshot &next, std::vector<jclass> &toRetransform,
+                                const jsize index, jclass cls, const std::span<const unsigned char> bytes) {
+    const std::string_view name = internalClassName(jvmti, cls);
+    if (name.empty()) {
+        nativeLog(LogLevel::Error, "[-] Failed to resolve name of class %d", index);
+        return false;
     }
+    next.stageInterned(name, bytes, canonicalLoaderOf(env, jvmti, cls));
+
+    jboolean mod = JNI_FALSE;
+    jvmti->IsModifiableClass(cls, &mod);
+    nativeLog(LogLevel::Debug, "Class %d modifiable: %s", index, mod ? "true" : "false");
+    toRetransform.push_back(cls);
+    return true;
+}
+
+// Publishes the batch, runs apply() with the hook armed for this thread, then
+// releases the batch so nothing stays armed.
+template<typename Apply>
+static void withStagedBatch(JNIEnv *env, std::unique_ptr<StagingSnapshot> next, const std::vector<jclass> &classes,
+                            Apply &&apply) {
+    std::lock_guard batchLock(retransformMutex);
+    publishStagingSnapshot(std::move(next)); {
+        ScopedClassFileLoadHook hook(env);
+        apply();
+    }
+    publishStagingSnapshot(nullptr);
+    forgetInstalledHashes(env, jvmti, classes);
+}
+
+static void retransformStaged(JNIEnv *env, std::unique_ptr<StagingSnapshot> next, std::vector<jclass> &toRetransform) {
+    jvmtiError err;
+    const std::size_t bytes = next->stagedBytes();
+    const std::uint64_t started = metricTicks();
+    withStagedBatch(env, std::move(next), toRetransform, [&] {
+        err = recordedRetransformClasses(jvmti, static_cast<jint>(toRetransform.size()), toRetransform.data());
+    });
+    recordApplyMetric(MetricOp::Retransform, err, toRetransform.size(), bytes, started);
+    nativeLog(outcomeLevel(err), "%s", err == JVMTI_ERROR_NONE ? "[+] Retransform success" : "[-] Retransform failed");
+}
+
+// Class definitions read from parallel Class[] and byte[][] arrays. The byte
+// arrays stay pinned and the local references alive until destruction.
+class ClassDefinitions {
+public:
+    ClassDefinitions(JNIEnv *env, jobjectArray classes, jobjectArray bytesArray) : env_(env) {
+        const jsize count = env->GetArrayLength(classes);
+        defs.resize(count);
+        ptrs_.resize(count);
+        classRefs_.resize(count);
+        arrayRefs_.resize(count);
 
-    std::vector<jclass> toRetransform; {
-        std::lock_guard lock(mapMutex);
-        classBytecodeMap.clear();
         for (jsize i = 0; i < count; ++i) {
-            auto cls = static_cast<jclass>(env->GetObjectArrayElement(classes, i));
-            auto arr = static_cast<jbyteArray>(env->GetObjectArrayElement(bytesArray, i));
-            if (!cls || !arr) continue;
+            jclass cls = static_cast<jclass>(env->GetObjectArrayElement(classes, i));
+            jbyteArray arr = static_cast<jbyteArray>(env->GetObjectArrayElement(bytesArray, i));
+            classRefs_[i] = cls;
+            arrayRefs_[i] = arr;
+
+            if (!cls || !arr) {
+                defs[i] = {nullptr, 0, nullptr};
+                continue;
+            }
 
-            std::string name = getInternalName(env, cls);
             jsize len = env->GetArrayLength(arr);
             jbyte *data = env->GetByteArrayElements(arr, nullptr);
+            defs[i] = {cls, len, reinterpret_cast<unsigned char *>(data)};
+            ptrs_[i] = data;
+        }
+    }
+
+    ~ClassDefinitions() {
+        for (std::size_t i = 0; i < defs.size(); ++i) {
+            if (ptrs_[i]) env_->ReleaseByteArrayElements(arrayRefs_[i], ptrs_[i], JNI_ABORT);
+            if (classRefs_[i]) env_->DeleteLocalRef(classRefs_[i]);
+            if (arrayRefs_[i]) env_->DeleteLocalRef(arrayRefs_[i]);
+        }
+    }
+
+    ClassDefinitions(const ClassDefinitions &) = delete;
+    ClassDefinitions &operator=(const ClassDefinitions &) = delete;
+
+    std::vector<jvmtiClassDefinition> defs;
+
+private:
+    JNIEnv *env_;
+    std::vector<jbyte *> ptrs_;
+    std::vector<jclass> classRefs_;
+    std::vector<jbyteArray> arrayRefs_;
+};
 
-            classBytecodeMap[name] = std::vector(
-                reinterpret_cast<unsigned char *>(data),
-                reinterpret_cast<unsigned char *>(data) + len
-            );
+static std::mutex commitMutex;
 
+// Retransforms only the staged classes that changed since the last commit.
+static jvmtiError commitStagedClasses(JNIEnv *env) {
+    std::lock_guard commitLock(commitMutex);
+    StagedCommit commit = prepareStagedCommit(env);
+    jvmtiError err = JVMTI_ERROR_NONE;
+    if (!commit.classes.empty()) {
+        const std::size_t bytes = commit.snapshot->stagedBytes();
+        const std::uint64_t started = metricTicks();
+        const auto startedAt = std::chrono::steady_clock::now();
+        withStagedBatch(env, std::move(commit.snapshot), commit.classes, [&] {
+            err = jvmti->RetransformClasses(static_cast<jint>(commit.classes.size()), commit.classes.data());
+        });
+        recordApplyMetric(MetricOp::Retransform, err, commit.classes.size(), bytes, started);
+        recordEvent({
+            .type = EventType::StagingCommit,
+            .flags = static_cast<std::uint16_t>(std::min<std::size_t>(commit.removed, 0xFFFF)),
+            .error = err, .count = static_cast<std::uint32_t>(commit.classes.size()), .bytes = bytes,
+            .duration = std::chrono::steady_clock::now() - startedAt
+        });
+    }
+    finishStagedCommit(env, commit, err == JVMTI_ERROR_NONE);
+    syncStickyHook();
+    nativeLog(outcomeLevel(err), "%s for %zu changed classes (%zu restored)%s",
+              err == JVMTI_ERROR_NONE ? "[+] Retransform success" : "[-] Retransform failed", commit.classes.size(),
+              commit.removed, err == JVMTI_ERROR_NONE ? "" : getErrorName(err));
+    return err;
+}
+
+static void redefineDefinitions(JNIEnv *env, const std::vector<jvmtiClassDefinition> &defs) {
+    const auto count = static_cast<jint>(defs.size());
+    std::size_t bytes = 0;
+    for (const jvmtiClassDefinition &def: defs) bytes += def.class_byte_count;
+    const std::uint64_t started = metricTicks();
+    jvmtiError err = recordedRedefineClasses(jvmti, count, defs.data());
+    recordApplyMetric(MetricOp::Redefine, err, defs.size(), bytes, started);
+    if (err == JVMTI_ERROR_NONE) recordInstalledDefinitions(env, jvmti, defs);
+    nativeLog(outcomeLevel(err), "%s for %d classes%s", err == JVMTI_ERROR_NONE ? "[+] Redefine success" : "[-] Redefine failed", count, err==JVMTI_ERROR_NONE ? "." : getErrorName(err));
+}
+
+// Direct buffers are read in place over their whole capacity; pass a slice to
+// select a sub-range. The caller keeps the buffer reachable for the call.
+static bool directBufferBytes(JNIEnv *env, jobject buffer, std::span<const unsigned char> &bytes) {
+    const auto *address = static_cast<const unsigned char *>(env->GetDirectBufferAddress(buffer));
+    const jlong capacity = env->GetDirectBufferCapacity(buffer);
+    if (!address || capacity < 0 || capacity > INT32_MAX) return false;
+    bytes = {address, static_cast<std::size_t>(capacity)};
+    return true;
+}
+
+static bool addressBytes(const jlong address, const jint length, std::span<const unsigned char> &bytes) {
+    if (address == 0 || length < 0) return false;
+    bytes = {reinterpret_cast<const unsigned char *>(static_cast<std::uintptr_t>(address)),
+             static_cast<std::size_t>(length)};
+    return true;
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_org_example_Native_retransformClass(JNIEnv *env, jclass, jobjectArray classes, jobjectArray bytesArray) {
+    if (!requireProfile(CapabilityProfile::Retransform)) return;
+
+    const jsize count = env->GetArrayLength(classes);
+    if (count != env->GetArrayLength(bytesArray)) {
+        nativeLog(LogLevel::Error, "[-] Array length mismatch");
+        return;
+    }
+
+    for (jsize i = 0; i < count; ++i) {
+        auto cls = static_cast<jclass>(env->GetObjectArrayElement(classes, i));
+        auto arr = static_cast<jbyteArray>(env->GetObjectArrayElement(bytesArray, i));
+        if (cls && arr) {
             jboolean mod = JNI_FALSE;
             jvmti->IsModifiableClass(cls, &mod);
-            printf("Class %d modifiable: %s\n", i, mod ? "true" : "false");
+            nativeLog(LogLevel::Debug, "Class %d modifiable: %s", i, mod ? "true" : "false");
 
-            env->ReleaseByteArrayElements(arr, data, JNI_ABORT);
-            env->DeleteLocalRef(arr);
-            toRetransform.push_back(cls);
+            if (const StagedKey key = stagedKeyOf(env, cls, false); !key.name.empty()) {
+                // copyJavaBytes releases arr.
+                stageClass(env, cls, key, copyJavaBytes(env, std::exchange(arr, nullptr)));
+            }
         }
+        // A large batch would otherwise overflow the native frame's local refs.
+        if (arr) env->DeleteLocalRef(arr);
+        if (cls) env->DeleteLocalRef(cls);
+    }
+    commitStagedClasses(env);
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_org_example_Native_stageClass(JNIEnv *env, jclass, jclass cls, jbyteArray bytes) {
+    if (!cls || !bytes) return;
+    if (const StagedKey key = stagedKeyOf(env, cls, false); !key.name.empty()) {
+        stageClass(env, cls, key, copyJavaBytes(env, bytes));
+    }
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_org_example_Native_stageClassAnyLoader(JNIEnv *env, jclass, jclass cls, jbyteArray bytes) {
+    if (!cls || !bytes) return;
+    if (const StagedKey key = stagedKeyOf(env, cls, true); !key.name.empty()) {
+        stageClass(env, cls, key, copyJavaBytes(env, bytes));
+    }
+}
+
+// Drops both the entry for cls's own loader and any entry staged for every
+// loader under cls's name.
+extern "C" JNIEXPORT void JNICALL
+Java_org_example_Native_unstageClass(JNIEnv *env, jclass, jclass cls) {
+    if (!cls) return;
+    if (const StagedKey key = stagedKeyOf(env, cls, false); !key.name.empty()) {
+        unstageClass(env, key);
+        unstageClass(env, {key.name, nullptr, true});
+        syncStickyHook();
     }
+}
+
+// Stages cls with a lifecycle, one of the LIFECYCLE_* constants.
+extern "C" JNIEXPORT void JNICALL
+Java_org_example_Native_stageClassWithMode(JNIEnv *env, jclass, jclass cls, jbyteArray bytes, jint lifecycle) {
+    if (!cls || !bytes) return;
+    if (lifecycle != org_example_Native_LIFECYCLE_ONE_SHOT && lifecycle != org_example_Native_LIFECYCLE_STICKY) {
+        nativeLog(LogLevel::Error, "[-] Unknown lifecycle %d", lifecycle);
+        return;
+    }
+    if (const StagedKey key = stagedKeyOf(env, cls, false); !key.name.empty()) {
+        stageClass(env, cls, key, copyJavaBytes(env, bytes), static_cast<StagedLifecycle>(lifecycle));
+        syncStickyHook();
+    }
+}
+
+// Caps the bytes kept for applied sticky classes; 0 or less removes the cap.
+extern "C" JNIEXPORT void JNICALL
+Java_org_example_Native_setStickyBudget(JNIEnv *, jclass, jlong bytes) {
+    setStickyByteBudget(bytes > 0 ? static_cast<std::size_t>(bytes) : 0);
+    syncStickyHook();
+}
 
-    jvmtiError err = jvmti->RetransformClasses(toRetransform.size(), toRetransform.data());
-    printf("%s\n", err == JVMTI_ERROR_NONE ? "[+] Retransform success" : "[-] Retransform failed");
+// {bytesHeld, stickyBytes, stickyBudget, stickyClasses, evictedClasses, evictedBytes, oneShotFreedClasses,
+//  oneShotFreedBytes}
+extern "C" JNIEXPORT jlongArray JNICALL
+Java_org_example_Native_getStagingMemoryStats(JNIEnv *env, jclass) {
+    const StagedMemoryStats stats = stagedMemoryStats();
+    const jlong values[] = {
+        stats.bytesHeld, stats.stickyBytes, stats.stickyBudget, stats.stickyClasses, stats.evictedClasses,
+        stats.evictedBytes, stats.oneShotFreedClasses, stats.oneShotFreedBytes
+    };
+    jlongArray result = env->NewLongArray(std::size(values));
+    if (result) env->SetLongArrayRegion(result, 0, std::size(values), values);
+    return result;
+}
+
+// level is one of the LOG_* constants; messages below it are discarded
+// before they reach the ring.
+extern "C" JNIEXPORT void JNICALL
+Java_org_example_Native_setLogLevel(JNIEnv *, jclass, jint level) {
+    if (level < org_example_Native_LOG_DEBUG || level > org_example_Native_LOG_OFF) {
+        nativeLog(LogLevel::Error, "[-] Unknown log level %d", level);
+        return;
+    }
+    setLogLevel(static_cast<LogLevel>(level));
+}
+
+// {logged, dropped, written}: records queued, records lost to a full ring,
+// and records the drainer has written out.
+extern "C" JNIEXPORT jlongArray JNICALL
+Java_org_example_Native_getLogStats(JNIEnv *env, jclass) {
+    const NativeLogStats stats = nativeLogStats();
+    const jlong values[] = {stats.logged, stats.dropped, stats.written};
+    jlongArray result = env->NewLongArray(std::size(values));
+    if (result) env->SetLongArrayRegion(result, 0, std::size(values), values);
+    return result;
+}
+
+// {opCount, fieldCount, then fieldCount values per op in MetricOp order (calls, hits, misses, bytes, failures,
+//  timedCalls, meanNanos, p50Nanos, p90Nanos, p99Nanos, p999Nanos, maxNanos), failureEntries, then
+//  (op, jvmtiError, count) per entry}
+extern "C" JNIEXPORT jlongArray JNICALL
+Java_org_example_Native_getStats(JNIEnv *env, jclass) {
+    const MetricsSnapshot snapshot = metricsSnapshot();
+    std::vector<jlong> flat{static_cast<jlong>(metricOpCount), static_cast<jlong>(metricFieldCount)};
+    for (const auto &fields: snapshot.fields) flat.insert(flat.end(), std::begin(fields), std::end(fields));
+    flat.push_back(static_cast<jlong>(snapshot.failures.size()));
+    for (const MetricFailureCount &failure: snapshot.failures) {
+        flat.insert(flat.end(), {static_cast<jlong>(failure.op), failure.error, failure.count});
+    }
+    jlongArray result = env->NewLongArray(static_cast<jsize>(flat.size()));
+    if (result) env->SetLongArrayRegion(result, 0, static_cast<jsize>(flat.size()), flat.data());
+    return result;
+}
+
+// Rewrites path with the stats in text form every intervalMillis; a null
+// path or a non-positive interval stops the exporter.
+extern "C" JNIEXPORT void JNICALL
+Java_org_example_Native_setStatsExporter(JNIEnv *env, jclass, jstring path, jlong intervalMillis) {
+    std::string file;
+    if (path) {
+        const char *chars = env->GetStringUTFChars(path, nullptr);
+        if (!chars) return;
+        file = chars;
+        env->ReleaseStringUTFChars(path, chars);
+    }
+    setMetricsExporter(std::move(file), std::chrono::milliseconds(intervalMillis));
+}
+
+// Starts recording library events into a ring file of capacity records at
+// path (see event_format.h for the layout and tools/event_decode for a
+// reader), replacing the current file. False if the file cannot be mapped.
+extern "C" JNIEXPORT jboolean JNICALL
+Java_org_example_Native_startEventRecorder(JNIEnv *env, jclass, jstring path, jint capacity) {
+    if (!path || capacity <= 0) return JNI_FALSE;
+    const char *chars = env->GetStringUTFChars(path, nullptr);
+    if (!chars) return JNI_FALSE;
+    const std::string file = chars;
+    env->ReleaseStringUTFChars(path, chars);
+    return openEventRecorder(file, static_cast<std::size_t>(capacity)) ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_org_example_Native_stopEventRecorder(JNIEnv *, jclass) {
+    closeEventRecorder();
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_org_example_Native_commitStaged(JNIEnv *env, jclass) {
+    if (!requireProfile(CapabilityProfile::Retransform)) return JVMTI_ERROR_MUST_POSSESS_CAPABILITY;
+    return commitStagedClasses(env);
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_org_example_Native_retransformClassDirect(JNIEnv *env, jclass, jobjectArray classes, jobjectArray buffers) {
+    if (!requireProfile(CapabilityProfile::Retransform)) return;
+
+    const jsize count = env->GetArrayLength(classes);
+    if (count != env->GetArrayLength(buffers)) {
+        nativeLog(LogLevel::Error, "[-] Array length mismatch");
+        return;
+    }
+
+    auto next = std::make_unique<StagingSnapshot>();
+    std::vector<jclass> toRetransform;
+    for (jsize i = 0; i < count; ++i) {
+        auto cls = static_cast<jclass>(env->GetObjectArrayElement(classes, i));
+        jobject buffer = env->GetObjectArrayElement(buffers, i);
+        std::span<const unsigned char> bytes;
+        if (!cls || !buffer) {
+            env->DeleteLocalRef(cls);
+            env->DeleteLocalRef(buffer);
+            continue;
+        }
+        // The buffers stay reachable through the array, so only the classes
+        // need a reference until the retransform.
+        const bool direct = directBufferBytes(env, buffer, bytes);
+        env->DeleteLocalRef(buffer);
+        if (!direct) {
+            nativeLog(LogLevel::Error, "[-] Class %d: not a direct buffer", i);
+            env->DeleteLocalRef(cls);
+            continue;
+        }
+        if (!stageForRetransform(env, *next, toRetransform, i, cls, bytes)) env->DeleteLocalRef(cls);
+    }
+    retransformStaged(env, std::move(next), toRetransform);
+    for (jclass cls: toRetransform) env->DeleteLocalRef(cls);
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_org_example_Native_retransformClassAddress(JNIEnv *env, jclass, jobjectArray classes, jlongArray addresses,
+                                                jintArray lengths) {
+    if (!requireProfile(CapabilityProfile::Retransform)) return;
+
+    const jsize count = env->GetArrayLength(classes);
+    if (count != env->GetArrayLength(addresses) || count != env->GetArrayLength(lengths)) {
+        nativeLog(LogLevel::Error, "[-] Array length mismatch");
+        return;
+    }
+
+    std::vector<jlong> address(count);
+    std::vector<jint> length(count);
+    env->GetLongArrayRegion(addresses, 0, count, address.data());
+    env->GetIntArrayRegion(lengths, 0, count, length.data());
+
+    auto next = std::make_unique<StagingSnapshot>();
+    std::vector<jclass> toRetransform;
+    for (jsize i = 0; i < count; ++i) {
+        auto cls = static_cast<jclass>(env->GetObjectArrayElement(classes, i));
+        std::span<const unsigned char> bytes;
+        if (!cls) continue;
+        if (!addressBytes(address[i], length[i], bytes)) {
+            nativeLog(LogLevel::Error, "[-] Class %d: invalid address range", i);
+            env->DeleteLocalRef(cls);
+            continue;
+        }
+        if (!stageForRetransform(env, *next, toRetransform, i, cls, bytes)) env->DeleteLocalRef(cls);
+    }
+    retransformStaged(env, std::move(next), toRetransform);
+    for (jclass cls: toRetransform) env->DeleteLocalRef(cls);
 }
 
 extern "C" JNIEXPORT void JNICALL
 Java_org_example_Native_redefineClass(JNIEnv *env, jclass, jobjectArray classes, jobjectArray bytesArray) {
-    if (!initJvmti(env)) return;
+    if (!requireProfile(CapabilityProfile::RedefineOnly)) return;
 
     const jsize count = env->GetArrayLength(classes);
     if (count != env->GetArrayLength(bytesArray)) {
-        printf("[-] Mismatched array lengths\n");
+        nativeLog(LogLevel::Error, "[-] Mismatched array lengths");
         return;
     }
 
-    std::vector<jvmtiClassDefinition> defs(count);
-    std::vector<jbyte *> ptrs(count);
-    std::vector<jclass> classRefs(count);
-    std::vector<jbyteArray> arrayRefs(count);
+    const ClassDefinitions definitions(env, classes, bytesArray);
+    redefineDefinitions(env, definitions.defs);
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_org_example_Native_redefineClassDirect(JNIEnv *env, jclass, jobjectArray classes, jobjectArray buffers) {
+    if (!requireProfile(CapabilityProfile::RedefineOnly)) return;
 
+    const jsize count = env->GetArrayLength(classes);
+    if (count != env->GetArrayLength(buffers)) {
+        nativeLog(LogLevel::Error, "[-] Mismatched array lengths");
+        return;
+    }
+
+    std::vector<jvmtiClassDefinition> defs(count);
     for (jsize i = 0; i < count; ++i) {
-        jclass cls = static_cast<jclass>(env->GetObjectArrayElement(classes, i));
-        jbyteArray arr = static_cast<jbyteArray>(env->GetObjectArrayElement(bytesArray, i));
-        classRefs[i] = cls;
-        arrayRefs[i] = arr;
+        auto cls = static_cast<jclass>(env->GetObjectArrayElement(classes, i));
+        jobject buffer = env->GetObjectArrayElement(buffers, i);
+        std::span<const unsigned char> bytes;
+        const bool direct = cls && buffer && directBufferBytes(env, buffer, bytes);
+        env->DeleteLocalRef(buffer);
+        if (!direct) {
+            env->DeleteLocalRef(cls);
+            defs[i] = {nullptr, 0, nullptr};
+            continue;
+        }
+        defs[i] = {cls, static_cast<jint>(bytes.size()), bytes.data()};
+    }
+    redefineDefinitions(env, defs);
+    for (const jvmtiClassDefinition &def: defs) env->DeleteLocalRef(def.klass);
+}
 
-        if (!cls || !arr) {
+extern "C" JNIEXPORT void JNICALL
+Java_org_example_Native_redefineClassAddress(JNIEnv *env, jclass, jobjectArray classes, jlongArray addresses,
+                                             jintArray lengths) {
+    if (!requireProfile(CapabilityProfile::RedefineOnly)) return;
+
+    const jsize count = env->GetArrayLength(classes);
+    if (count != env->GetArrayLength(addresses) || count != env->GetArrayLength(lengths)) {
+        nativeLog(LogLevel::Error, "[-] Mismatched array lengths");
+        return;
+    }
+
+    std::vector<jlong> address(count);
+    std::vector<jint> length(count);
+    env->GetLongArrayRegion(addresses, 0, count, address.data());
+    env->GetIntArrayRegion(lengths, 0, count, length.data());
+
+    std::vector<jvmtiClassDefinition> defs(count);
+    for (jsize i = 0; i < count; ++i) {
+        auto cls = static_cast<jclass>(env->GetObjectArrayElement(classes, i));
+        std::span<const unsigned char> bytes;
+        if (!cls || !addressBytes(address[i], length[i], bytes)) {
+            env->DeleteLocalRef(cls);
             defs[i] = {nullptr, 0, nullptr};
             continue;
         }
+        defs[i] = {cls, length[i], bytes.data()};
+    }
+    redefineDefinitions(env, defs);
+    for (const jvmtiClassDefinition &def: defs) env->DeleteLocalRef(def.klass);
+}
 
-        jsize len = env->GetArrayLength(arr);
-        jbyte *data = env->GetByteArrayElements(arr, nullptr);
-        defs[i] = {cls, len, reinterpret_cast<unsigned char *>(data)};
-        ptrs[i] = data;
+static std::vector<int> readGroups(JNIEnv *env, jintArray groups, const jsize count) {
+    std::vector<int> result(count, -1);
+    if (groups && env->GetArrayLength(groups) == count) {
+        env->GetIntArrayRegion(groups, 0, count, reinterpret_cast<jint *>(result.data()));
     }
+    return result;
+}
+
+// Flattens the per-chunk report as {pauseNanos, classCount, jvmtiError} triples,
+// followed by one entry per input class: the index of the chunk that applied
+// it, or -1 if it was skipped or never reached. inputIndex maps the positions
+// in a chunk's indices back to input classes.
+static jlongArray chunkReport(JNIEnv *env, const std::vector<PauseBudgetChunk> &chunks,
+                              const std::span<const jsize> inputIndex, const jsize count) {
+    std::vector<jlong> flat;
+    flat.reserve(chunks.size() * 3 + count);
+    for (const auto &chunk: chunks) {
+        nativeLog(LogLevel::Info, "[*] Chunk of %zu classes paused %.3f ms%s%s", chunk.classCount,
+                  chunk.pauseNanos / 1e6, chunk.error ? ": " : "", chunk.error ? getErrorName(static_cast<jvmtiError>(chunk.error)) : "");
+        flat.insert(flat.end(), {chunk.pauseNanos, static_cast<jlong>(chunk.classCount), chunk.error});
+    }
+    const std::size_t chunkOfClass = flat.size();
+    flat.resize(chunkOfClass + count, -1);
+    for (std::size_t c = 0; c < chunks.size(); ++c) {
+        for (const std::size_t i: chunks[c].indices) flat[chunkOfClass + inputIndex[i]] = static_cast<jlong>(c);
+    }
+    jlongArray result = env->NewLongArray(static_cast<jsize>(flat.size()));
+    if (result) env->SetLongArrayRegion(result, 0, static_cast<jsize>(flat.size()), flat.data());
+    return result;
+}
 
-    jvmtiError err = jvmti->RedefineClasses(count, defs.data());
-    printf("%s for %d classes%s", err == JVMTI_ERROR_NONE ? "[+] Redefine success" : "[-] Redefine failed", count, err==JVMTI_ERROR_NONE ? ".\n" : getErrorName(err));
+// A budget must be positive; otherwise nothing is applied and the report is
+// a single empty chunk failed with JVMTI_ERROR_ILLEGAL_ARGUMENT.
+static bool validPauseBudget(JNIEnv *env, const jint pauseBudgetMillis, const jsize count, jlongArray &rejected) {
+    if (pauseBudgetMillis > 0) return true;
+    nativeLog(LogLevel::Error, "[-] Pause budget must be positive, got %d ms", pauseBudgetMillis);
+    rejected = chunkReport(env, {{0, 0, JVMTI_ERROR_ILLEGAL_ARGUMENT, {}}}, {}, count);
+    return false;
+}
+
+extern "C" JNIEXPORT jlongArray JNICALL
+Java_org_example_Native_redefineClassBudgeted(JNIEnv *env, jclass, jobjectArray classes, jobjectArray bytesArray,
+                                              jint pauseBudgetMillis, jintArray groups) {
+    if (!requireProfile(CapabilityProfile::RedefineOnly)) return nullptr;
 
+    const jsize count = env->GetArrayLength(classes);
+    if (count != env->GetArrayLength(bytesArray)) {
+        nativeLog(LogLevel::Error, "[-] Mismatched array lengths");
+        return nullptr;
+    }
+    if (jlongArray rejected = nullptr; !validPauseBudget(env, pauseBudgetMillis, count, rejected)) return rejected;
+
+    const ClassDefinitions definitions(env, classes, bytesArray);
+    std::vector<std::size_t> sizes(count);
+    for (jsize i = 0; i < count; ++i) sizes[i] = definitions.defs[i].class_byte_count;
+
+    std::vector<jvmtiClassDefinition> chunk;
+    const auto chunks = runWithinPauseBudget(
+        sizes, readGroups(env, groups, count), std::chrono::milliseconds(pauseBudgetMillis),
+        [&](const std::span<const std::size_t> indices) {
+            chunk.clear();
+            std::size_t bytes = 0;
+            for (const std::size_t i: indices) {
+                chunk.push_back(definitions.defs[i]);
+                bytes += sizes[i];
+            }
+            const std::uint64_t started = metricTicks();
+            const jvmtiError err = recordedRedefineClasses(jvmti, static_cast<jint>(chunk.size()), chunk.data());
+            recordApplyMetric(MetricOp::Redefine, err, chunk.size(), bytes, started);
+            return static_cast<int>(err);
+        });
+    // Hashed after the run, so the pause measured for each chunk is the
+    // RedefineClasses call alone.
+    chunk.clear();
+    for (const PauseBudgetChunk &applied: chunks) {
+        if (applied.error != JVMTI_ERROR_NONE) continue;
+        for (const std::size_t i: applied.indices) chunk.push_back(definitions.defs[i]);
+    }
+    recordInstalledDefinitions(env, jvmti, chunk);
+    std::vector<jsize> inputIndex(count);
+    std::iota(inputIndex.begin(), inputIndex.end(), 0);
+    return chunkReport(env, chunks, inputIndex, count);
+}
+
+extern "C" JNIEXPORT jlongArray JNICALL
+Java_org_example_Native_retransformClassBudgeted(JNIEnv *env, jclass, jobjectArray classes, jobjectArray bytesArray,
+                                                 jint pauseBudgetMillis, jintArray groups) {
+    if (!requireProfile(CapabilityProfile::Retransform)) return nullptr;
+
+    const jsize count = env->GetArrayLength(classes);
+    if (count != env->GetArrayLength(bytesArray)) {
+        nativeLog(LogLevel::Error, "[-] Array length mismatch");
+        return nullptr;
+    }
+    if (jlongArray rejected = nullptr; !validPauseBudget(env, pauseBudgetMillis, count, rejected)) return rejected;
+
+    const std::vector<int> requestedGroups = readGroups(env, groups, count);
+    std::size_t expectedBytes = 0;
     for (jsize i = 0; i < count; ++i) {
-        if (ptrs[i]) env->ReleaseByteArrayElements(arrayRefs[i], ptrs[i], JNI_ABORT);
-        if (classRefs[i]) env->DeleteLocalRef(classRefs[i]);
-        if (arrayRefs[i]) env->DeleteLocalRef(arrayRefs[i]);
+        jobject arr = env->GetObjectArrayElement(bytesArray, i);
+        if (arr) expectedBytes += env->GetArrayLength(static_cast<jbyteArray>(arr));
+        env->DeleteLocalRef(arr);
     }
+
+    auto next = std::make_unique<StagingSnapshot>(expectedBytes);
+    next->reserve(count);
+    std::vector<jclass> toRetransform;
+    std::vector<std::size_t> sizes;
+    std::vector<int> stagedGroups;
+    std::vector<jsize> inputIndex;
+    for (jsize i = 0; i < count; ++i) {
+        auto cls = static_cast<jclass>(env->GetObjectArrayElement(classes, i));
+        auto arr = static_cast<jbyteArray>(env->GetObjectArrayElement(bytesArray, i));
+        if (!cls || !arr) continue;
+
+        const auto bytes = copyIntoSnapshot(env, *next, arr);
+        // sizes, stagedGroups and inputIndex stay index-aligned with toRetransform.
+        if (!stageForRetransform(env, *next, toRetransform, i, cls, bytes)) continue;
+        sizes.push_back(bytes.size());
+        stagedGroups.push_back(requestedGroups[i]);
+        inputIndex.push_back(i);
+    }
+
+    std::vector<PauseBudgetChunk> chunks;
+    std::vector<jclass> chunk;
+    withStagedBatch(env, std::move(next), toRetransform, [&] {
+        chunks = runWithinPauseBudget(
+            sizes, stagedGroups, std::chrono::milliseconds(pauseBudgetMillis),
+            [&](const std::span<const std::size_t> indices) {
+                chunk.clear();
+                std::size_t bytes = 0;
+                for (const std::size_t i: indices) {
+                    chunk.push_back(toRetransform[i]);
+                    bytes += sizes[i];
+                }
+                const std::uint64_t started = metricTicks();
+                const jvmtiError err =
+                    recordedRetransformClasses(jvmti, static_cast<jint>(chunk.size()), chunk.data());
+                recordApplyMetric(MetricOp::Retransform, err, chunk.size(), bytes, started);
+                return static_cast<int>(err);
+            });
+    });
+    return chunkReport(env, chunks, inputIndex, count);
 }
 
-static jclass optionalClass;
-static jmethodID ofMethod;
-static jmethodID emptyMethod;
+static jintArray toIntArray(JNIEnv *env, const std::vector<jint> &values) {
+    jintArray result = env->NewIntArray(static_cast<jsize>(values.size()));
+    if (result) env->SetIntArrayRegion(result, 0, static_cast<jsize>(values.size()), values.data());
+    return result;
+}
 
-void prepareOptional(JNIEnv *env) {
-    if (optionalClass == nullptr) {
-        optionalClass = env->FindClass("java/util/Optional");
+extern "C" JNIEXPORT jlong JNICALL
+Java_org_example_Native_redefineClassAsync(JNIEnv *env, jclass, jobjectArray classes, jobjectArray bytesArray) {
+    if (!requireProfile(CapabilityProfile::RedefineOnly)) return 0;
+
+    if (env->GetArrayLength(classes) != env->GetArrayLength(bytesArray)) {
+        nativeLog(LogLevel::Error, "[-] Mismatched array lengths");
+        return 0;
     }
-    if (ofMethod == nullptr) {
-        ofMethod = env->GetStaticMethodID(optionalClass, "of", "(Ljava/lang/Object;)Ljava/util/Optional;");
+    return static_cast<jlong>(submitRedefineJob(env, jvmti, classes, bytesArray));
+}
+
+// Returns per-class jvmtiError codes, null while the job is still running, or
+// {STATUS_UNKNOWN_HANDLE} for a handle never issued, already awaited or
+// expired.
+extern "C" JNIEXPORT jintArray JNICALL
+Java_org_example_Native_awaitRedefine(JNIEnv *env, jclass, jlong handle, jlong timeoutMillis) {
+    std::vector<jint> status;
+    switch (awaitRedefineJob(static_cast<std::uint64_t>(handle),
+                             std::chrono::milliseconds(std::max<jlong>(timeoutMillis, 0)), status)) {
+        case RedefineJobState::Running:
+            return nullptr;
+        case RedefineJobState::Unknown:
+            status = {org_example_Native_STATUS_UNKNOWN_HANDLE};
+            break;
+        case RedefineJobState::Done:
+            break;
+    }
+    return toIntArray(env, status);
+}
+
+// Blocks until the batch holding these classes has been applied.
+extern "C" JNIEXPORT jintArray JNICALL
+Java_org_example_Native_redefineClassCoalesced(JNIEnv *env, jclass, jobjectArray classes, jobjectArray bytesArray) {
+    if (!requireProfile(CapabilityProfile::RedefineOnly)) return nullptr;
+
+    if (env->GetArrayLength(classes) != env->GetArrayLength(bytesArray)) {
+        nativeLog(LogLevel::Error, "[-] Mismatched array lengths");
+        return nullptr;
     }
-    if (emptyMethod == nullptr) {
-        emptyMethod = env->GetStaticMethodID(optionalClass, "empty", "()Ljava/util/Optional;");
+    const std::uint64_t handle = submitRedefineJob(env, jvmti, classes, bytesArray);
+    if (handle == 0) return nullptr;
+
+    std::vector<jint> status;
+    RedefineJobState state;
+    while ((state = awaitRedefineJob(handle, std::chrono::hours(1), status)) == RedefineJobState::Running) {
     }
+    if (state == RedefineJobState::Unknown) status = {org_example_Native_STATUS_UNKNOWN_HANDLE};
+    return toIntArray(env, status);
 }
 
-jobject ofOptional(JNIEnv *env, jobject obj) {
-    prepareOptional(env);
+extern "C" JNIEXPORT void JNICALL
+Java_org_example_Native_setRedefineCoalescing(JNIEnv *, jclass, jint windowMillis, jint maxBatch) {
+    setRedefineCoalescing(std::chrono::milliseconds(windowMillis), maxBatch > 0 ? maxBatch : SIZE_MAX);
+}
+
+// {queueDepth, submitted, completed, lastQueueNanos, maxQueueNanos, lastServiceNanos, maxServiceNanos,
+//  redefineCalls, supersededClasses}
+extern "C" JNIEXPORT jlongArray JNICALL
+Java_org_example_Native_getRedefineWorkerStats(JNIEnv *env, jclass) {
+    const RedefineWorkerStats stats = redefineWorkerStats();
+    const jlong values[] = {
+        stats.queueDepth, stats.submitted, stats.completed, stats.lastQueueNanos, stats.maxQueueNanos,
+        stats.lastServiceNanos, stats.maxServiceNanos, stats.redefineCalls, stats.supersededClasses
+    };
+    jlongArray result = env->NewLongArray(std::size(values));
+    if (result) env->SetLongArrayRegion(result, 0, std::size(values), values);
+    return result;
+}
+
+extern "C" JNIEXPORT jintArray JNICALL
+Java_org_example_Native_redefineChangedClasses(JNIEnv *env, jclass, jobjectArray classes, jobjectArray bytesArray) {
+    if (!requireProfile(CapabilityProfile::RedefineOnly)) return nullptr;
+
+    const jsize count = env->GetArrayLength(classes);
+    if (count != env->GetArrayLength(bytesArray)) {
+        nativeLog(LogLevel::Error, "[-] Mismatched array lengths");
+        return nullptr;
+    }
+
+    const ClassDefinitions definitions(env, classes, bytesArray);
+    std::vector<jint> status(count, JVMTI_ERROR_NULL_POINTER);
+    std::vector<std::uint64_t> hashes(count);
+    std::vector<jvmtiClassDefinition> changed;
+    std::vector<jsize> changedIndex;
+    std::size_t changedBytes = 0;
+    for (jsize i = 0; i < count; ++i) {
+        const jvmtiClassDefinition &def = definitions.defs[i];
+        if (!def.klass) continue;
+
+        hashes[i] = contentHash({def.class_bytes, static_cast<std::size_t>(def.class_byte_count)});
+        if (installedHashMatches(env, jvmti, def.klass, hashes[i])) {
+            status[i] = org_example_Native_STATUS_UNCHANGED;
+            continue;
+        }
+        changed.push_back(def);
+        changedIndex.push_back(i);
+        changedBytes += def.class_byte_count;
+    }
+
+    jvmtiError err = JVMTI_ERROR_NONE;
+    if (!changed.empty()) {
+        const std::uint64_t started = metricTicks();
+        err = recordedRedefineClasses(jvmti, static_cast<jint>(changed.size()), changed.data());
+        recordApplyMetric(MetricOp::Redefine, err, changed.size(), changedBytes, started);
+    }
+    for (const jsize i: changedIndex) {
+        status[i] = err;
+        if (err == JVMTI_ERROR_NONE) recordInstalledHash(env, jvmti, definitions.defs[i].klass, hashes[i]);
+    }
+    nativeLog(outcomeLevel(err), "%s for %zu of %d classes%s",
+              err == JVMTI_ERROR_NONE ? "[+] Redefine success" : "[-] Redefine failed", changed.size(), count, err == JVMTI_ERROR_NONE ? "" : getErrorName(err));
+    return toIntArray(env, status);
+}
+
+// Keeps global hook delivery on exactly while first-load definitions wait.
+static void syncFirstLoadHook() {
+    firstLoadHook.sync(pendingFirstLoadDefinitions);
+}
+
+// The hook notifies without taking sweeperMutex, so a wakeup can be missed;
+// the sweeper also checks for a scheduled sweep this often.
+static constexpr auto firstLoadSweepInterval = std::chrono::milliseconds(100);
+static std::atomic<bool> firstLoadSweepScheduled{false};
+static std::mutex sweeperMutex;
+static std::condition_variable sweepRequested;
+static bool sweeperStopping = false;
+static std::thread *firstLoadSweeper = nullptr;
+
+// The hook consumed the last pending definition but must not block, so the
+// sweeper thread drops the consumed bytes and releases global delivery.
+static void scheduleFirstLoadSweep() {
+    if (!firstLoadSweepScheduled.exchange(true)) sweepRequested.notify_one();
+}
+
+static void sweepFirstLoads(JavaVM *vm) {
+    JNIEnv *env = nullptr;
+    JavaVMAttachArgs args{JNI_VERSION_1_8, const_cast<char *>("JNILibrary first-load sweep"), nullptr};
+    if (vm->AttachCurrentThreadAsDaemon(reinterpret_cast<void **>(&env), &args) != JNI_OK) {
+        nativeLog(LogLevel::Error, "[-] Failed to attach first-load sweeper");
+        return;
+    }
+    std::unique_lock lock(sweeperMutex);
+    while (!sweeperStopping) {
+        sweepRequested.wait_for(lock, firstLoadSweepInterval,
+                                [] { return sweeperStopping || firstLoadSweepScheduled.load(); });
+        // Cleared first: a definition added and consumed while this runs
+        // schedules another sweep.
+        if (sweeperStopping || !firstLoadSweepScheduled.exchange(false)) continue;
+        lock.unlock();
+        sweepFirstLoadDefinitions();
+        syncFirstLoadHook();
+        lock.lock();
+    }
+    lock.unlock();
+    vm->DetachCurrentThread();
+}
+
+// Started with the first definition, from a thread that may block.
+static void startFirstLoadSweeper(JNIEnv *env) {
+    std::lock_guard lock(sweeperMutex);
+    JavaVM *vm = nullptr;
+    if (firstLoadSweeper || env->GetJavaVM(&vm) != JNI_OK || !vm) return;
+    firstLoadSweeper = new std::thread(sweepFirstLoads, vm);
+}
+
+static void stopFirstLoadSweeper() {
+    std::thread *stopped = nullptr;
+    {
+        std::lock_guard lock(sweeperMutex);
+        stopped = std::exchange(firstLoadSweeper, nullptr);
+        if (!stopped) return;
+        sweeperStopping = true;
+    }
+    sweepRequested.notify_all();
+    stopped->join();
+    delete stopped;
+    std::lock_guard lock(sweeperMutex);
+    sweeperStopping = false;
+}
+
+static jobjectArray toStringArray(JNIEnv *env, const std::vector<std::string_view> &names) {
+    jobjectArray result = env->NewObjectArray(static_cast<jsize>(names.size()), stringClass, nullptr);
+    for (std::size_t i = 0; result && i < names.size(); ++i) {
+        // Interned names are NUL-terminated.
+        jstring name = env->NewStringUTF(names[i].data());
+        env->SetObjectArrayElement(result, static_cast<jsize>(i), name);
+        env->DeleteLocalRef(name);
+    }
+    return result;
+}
+
+// Registers bytes for the class named className, to be substituted the first
+// time it is loaded by loader (null: bootstrap) or, with anyLoader, by any
+// loader. The class must not be loaded yet; nothing is retransformed.
+extern "C" JNIEXPORT void JNICALL
+Java_org_example_Native_defineOnFirstLoad(JNIEnv *env, jclass, jstring className, jbyteArray bytes, jobject loader,
+                                          jboolean anyLoader) {
+    if (!className || !bytes) return;
+    std::string name;
+    readInternalName(env, className, name);
+    const StagedKey key{internName(name), anyLoader ? nullptr : canonicalLoader(env, jvmti, loader), anyLoader != 0};
+    startFirstLoadSweeper(env);
+    addFirstLoadDefinition(key, copyJavaBytes(env, bytes));
+    syncFirstLoadHook();
+}
+
+extern "C" JNIEXPORT jobjectArray JNICALL
+Java_org_example_Native_getUnfiredFirstLoads(JNIEnv *env, jclass) {
+    std::vector<std::string_view> unfired;
+    unfiredFirstLoadDefinitions(unfired);
+    syncFirstLoadHook();
+    return toStringArray(env, unfired);
+}
+
+extern "C" JNIEXPORT jobjectArray JNICALL
+Java_org_example_Native_clearFirstLoads(JNIEnv *env, jclass) {
+    std::vector<std::string_view> unfired;
+    clearFirstLoadDefinitions(unfired);
+    syncFirstLoadHook();
+    return toStringArray(env, unfired);
+}
+
+// True when cls was defined by one of loaders (a null element stands for the
+// bootstrap loader), or when no filter was given.
+static bool loaderAllowed(JNIEnv *env, jclass cls, jobjectArray loaders) {
+    if (!loaders) return true;
+    jobject loader = nullptr;
+    jvmti->GetClassLoader(cls, &loader);
+    bool allowed = false;
+    const jsize count = env->GetArrayLength(loaders);
+    for (jsize i = 0; i < count && !allowed; ++i) {
+        jobject candidate = env->GetObjectArrayElement(loaders, i);
+        allowed = candidate ? loader && env->IsSameObject(candidate, loader) : !loader;
+        env->DeleteLocalRef(candidate);
+    }
+    if (loader) env->DeleteLocalRef(loader);
+    return allowed;
+}
+
+// Redefines every loaded copy of each named class, across all loaders or only
+// those in loaders, in one RedefineClasses call. Result i is the number of
+// copies of classNames[i] patched, or minus the jvmtiError if the call failed.
+extern "C" JNIEXPORT jintArray JNICALL
+Java_org_example_Native_redefineByName(JNIEnv *env, jclass, jobjectArray classNames, jobjectArray bytesArray,
+                                       jobjectArray loaders) {
+    if (!requireProfile(CapabilityProfile::RedefineOnly) || !ensureLoadedClassIndex(env, jvmti)) return nullptr;
+
+    const jsize count = env->GetArrayLength(classNames);
+    if (count != env->GetArrayLength(bytesArray)) {
+        nativeLog(LogLevel::Error, "[-] Mismatched array lengths");
+        return nullptr;
+    }
+
+    std::vector<jint> copies(count);
+    std::vector<std::vector<unsigned char> > bytes(count);
+    std::vector<jvmtiClassDefinition> defs;
+    std::vector<jsize> owner;
+    std::string name;
+    for (jsize i = 0; i < count; ++i) {
+        auto className = static_cast<jstring>(env->GetObjectArrayElement(classNames, i));
+        auto arr = static_cast<jbyteArray>(env->GetObjectArrayElement(bytesArray, i));
+        if (className && arr) {
+            readInternalName(env, className, name);
+            bytes[i].resize(env->GetArrayLength(arr));
+            env->GetByteArrayRegion(arr, 0, static_cast<jsize>(bytes[i].size()),
+                                    reinterpret_cast<jbyte *>(bytes[i].data()));
+            for (jclass cls: findLoadedClasses(env, name)) {
+                if (!loaderAllowed(env, cls, loaders)) {
+                    env->DeleteLocalRef(cls);
+                    continue;
+                }
+                defs.push_back({cls, static_cast<jint>(bytes[i].size()), bytes[i].data()});
+                owner.push_back(i);
+            }
+        }
+        env->DeleteLocalRef(className);
+        env->DeleteLocalRef(arr);
+    }
 
+    jvmtiError err = JVMTI_ERROR_NONE;
+    if (!defs.empty()) {
+        std::size_t bytesApplied = 0;
+        for (const jvmtiClassDefinition &def: defs) bytesApplied += def.class_byte_count;
+        const std::uint64_t started = metricTicks();
+        err = recordedRedefineClasses(jvmti, static_cast<jint>(defs.size()), defs.data());
+        recordApplyMetric(MetricOp::Redefine, err, defs.size(), bytesApplied, started);
+    }
+    if (err == JVMTI_ERROR_NONE) recordInstalledDefinitions(env, jvmti, defs);
+    for (const jsize i: owner) {
+        copies[i] = err == JVMTI_ERROR_NONE ? copies[i] + 1 : -static_cast<jint>(err);
+    }
+    for (const jvmtiClassDefinition &def: defs) env->DeleteLocalRef(def.klass);
+    nativeLog(outcomeLevel(err), "%s for %zu copies of %d classes%s",
+              err == JVMTI_ERROR_NONE ? "[+] Redefine success" : "[-] Redefine failed", defs.size(), count, err == JVMTI_ERROR_NONE ? "" : getErrorName(err));
+    return toIntArray(env, copies);
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_org_example_Native_requestCapabilityProfile(JNIEnv *, jclass, jint profile) {
+    if (profile < 0 || profile >= capabilityProfileCount) {
+        nativeLog(LogLevel::Error, "[-] Unknown capability profile %d", profile);
+        return JNI_FALSE;
+    }
+    return requireProfile(static_cast<CapabilityProfile>(profile)) ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_org_example_Native_getCapabilityProfiles(JNIEnv *, jclass) {
+    return acquiredCapabilityProfiles();
+}
+
+jobject ofOptional(JNIEnv *env, jobject obj) {
     if (obj != nullptr) {
         return env->CallStaticObjectMethod(optionalClass, ofMethod, obj);
     }
@@ -243,9 +1228,165 @@ jobject ofOptional(JNIEnv *env, jobject obj) {
 
 extern "C" JNIEXPORT jobject JNICALL
 Java_org_example_Native_accessClass(JNIEnv *env, jclass, jstring className) {
-    std::string name = toCppString(env, className);
-    std::ranges::replace(name, '.', '/');
-
-    jclass cls = env->FindClass(name.c_str());
+    std::string name;
+    readInternalName(env, className, name);
+    const std::uint64_t started = metricTicks();
+    jclass cls = cachedFindClass(env, name);
+    recordTimedMetric(MetricOp::AccessClass, cls != nullptr, cls == nullptr, 0, started);
     return ofOptional(env, cls);
 }
+
+extern "C" JNIEXPORT jobjectArray JNICALL
+Java_org_example_Native_accessClasses(JNIEnv *env, jclass, jobjectArray classNames) {
+    const jsize count = env->GetArrayLength(classNames);
+    jobjectArray result = env->NewObjectArray(count, classClass, nullptr);
+    if (!result) return nullptr;
+
+    std::string name;
+    std::uint64_t found = 0;
+    const std::uint64_t started = metricTicks();
+    for (jsize i = 0; i < count; ++i) {
+        auto className = static_cast<jstring>(env->GetObjectArrayElement(classNames, i));
+        if (!className) continue;
+        readInternalName(env, className, name);
+        env->DeleteLocalRef(className);
+
+        if (jclass cls = cachedFindClass(env, name)) {
+            env->SetObjectArrayElement(result, i, cls);
+            env->DeleteLocalRef(cls);
+            found++;
+        }
+    }
+    recordTimedMetric(MetricOp::AccessClass, found, count - found, 0, started);
+    return result;
+}
+
+// Moves the local references in classes into a new Class[].
+static jobjectArray toClassArray(JNIEnv *env, const std::vector<jclass> &classes) {
+    jobjectArray result = env->NewObjectArray(static_cast<jsize>(classes.size()), classClass, nullptr);
+    for (std::size_t i = 0; i < classes.size(); ++i) {
+        if (result) env->SetObjectArrayElement(result, static_cast<jsize>(i), classes[i]);
+        env->DeleteLocalRef(classes[i]);
+    }
+    return result;
+}
+
+extern "C" JNIEXPORT jobjectArray JNICALL
+Java_org_example_Native_findLoadedClasses(JNIEnv *env, jclass, jstring className) {
+    if (!className || !ensureLoadedClassIndex(env, jvmti)) return nullptr;
+    std::string name;
+    readInternalName(env, className, name);
+    return toClassArray(env, findLoadedClasses(env, name));
+}
+
+extern "C" JNIEXPORT jobjectArray JNICALL
+Java_org_example_Native_findLoadedClassesByPrefix(JNIEnv *env, jclass, jstring prefix) {
+    if (!prefix || !ensureLoadedClassIndex(env, jvmti)) return nullptr;
+    std::string name;
+    readInternalName(env, prefix, name);
+    return toClassArray(env, findLoadedClassesWithPrefix(env, name));
+}
+
+extern "C" JNIEXPORT jobjectArray JNICALL
+Java_org_example_Native_findLoadedClassesByLoader(JNIEnv *env, jclass, jobject loader) {
+    if (!ensureLoadedClassIndex(env, jvmti)) return nullptr;
+    return toClassArray(env, findLoadedClassesOfLoader(env, jvmti, loader));
+}
+
+// Turns off the events the index lives on; the next lookup rebuilds it.
+extern "C" JNIEXPORT void JNICALL
+Java_org_example_Native_closeLoadedClassIndex(JNIEnv *env, jclass) {
+    closeLoadedClassIndex(env, jvmti);
+}
+
+#define NATIVE(name, signature) \
+    {const_cast<char *>(#name), const_cast<char *>(signature), reinterpret_cast<void *>(Java_org_example_Native_##name)}
+
+// Keep in step with org_example_Native.h.
+static const JNINativeMethod nativeMethods[] = {
+    NATIVE(redefineClass, "([Ljava/lang/Class;[[B)V"),
+    NATIVE(retransformClass, "([Ljava/lang/Class;[[B)V"),
+    NATIVE(accessClass, "(Ljava/lang/String;)Ljava/util/Optional;"),
+    NATIVE(requestCapabilityProfile, "(I)Z"),
+    NATIVE(getCapabilityProfiles, "()I"),
+    NATIVE(retransformClassDirect, "([Ljava/lang/Class;[Ljava/nio/ByteBuffer;)V"),
+    NATIVE(retransformClassAddress, "([Ljava/lang/Class;[J[I)V"),
+    NATIVE(redefineClassDirect, "([Ljava/lang/Class;[Ljava/nio/ByteBuffer;)V"),
+    NATIVE(redefineClassAddress, "([Ljava/lang/Class;[J[I)V"),
+    NATIVE(redefineClassBudgeted, "([Ljava/lang/Class;[[BI[I)[J"),
+    NATIVE(retransformClassBudgeted, "([Ljava/lang/Class;[[BI[I)[J"),
+    NATIVE(redefineClassAsync, "([Ljava/lang/Class;[[B)J"),
+    NATIVE(awaitRedefine, "(JJ)[I"),
+    NATIVE(getRedefineWorkerStats, "()[J"),
+    NATIVE(redefineClassCoalesced, "([Ljava/lang/Class;[[B)[I"),
+    NATIVE(setRedefineCoalescing, "(II)V"),
+    NATIVE(redefineChangedClasses, "([Ljava/lang/Class;[[B)[I"),
+    NATIVE(stageClass, "(Ljava/lang/Class;[B)V"),
+    NATIVE(unstageClass, "(Ljava/lang/Class;)V"),
+    NATIVE(commitStaged, "()I"),
+    NATIVE(accessClasses, "([Ljava/lang/String;)[Ljava/lang/Class;"),
+    NATIVE(findLoadedClasses, "(Ljava/lang/String;)[Ljava/lang/Class;"),
+    NATIVE(findLoadedClassesByPrefix, "(Ljava/lang/String;)[Ljava/lang/Class;"),
+    NATIVE(findLoadedClassesByLoader, "(Ljava/lang/ClassLoader;)[Ljava/lang/Class;"),
+    NATIVE(closeLoadedClassIndex, "()V"),
+    NATIVE(stageClassAnyLoader, "(Ljava/lang/Class;[B)V"),
+    NATIVE(redefineByName, "([Ljava/lang/String;[[B[Ljava/lang/ClassLoader;)[I"),
+    NATIVE(defineOnFirstLoad, "(Ljava/lang/String;[BLjava/lang/ClassLoader;Z)V"),
+    NATIVE(getUnfiredFirstLoads, "()[Ljava/lang/String;"),
+    NATIVE(clearFirstLoads, "()[Ljava/lang/String;"),
+    NATIVE(stageClassWithMode, "(Ljava/lang/Class;[BI)V"),
+    NATIVE(setStickyBudget, "(J)V"),
+    NATIVE(getStagingMemoryStats, "()[J"),
+    NATIVE(setLogLevel, "(I)V"),
+    NATIVE(getLogStats, "()[J"),
+    NATIVE(getStats, "()[J"),
+    NATIVE(setStatsExporter, "(Ljava/lang/String;J)V"),
+    NATIVE(startEventRecorder, "(Ljava/lang/String;I)Z"),
+    NATIVE(stopEventRecorder, "()V"),
+};
+
+#undef NATIVE
+
+extern "C" JNIEXPORT jint JNICALL
+JNI_OnLoad(JavaVM *vm, void *) {
+    startNativeLog();
+    JNIEnv *env = nullptr;
+    if (vm->GetEnv(reinterpret_cast<void **>(&env), JNI_VERSION_1_8) != JNI_OK || !env) return JNI_ERR;
+    if (!initJvmti(vm) || !cacheJavaIds(env)) return JNI_ERR;
+
+    jclass nativeClass = env->FindClass("org/example/Native");
+    if (!nativeClass) return JNI_ERR;
+    const jint registered = env->RegisterNatives(nativeClass, nativeMethods, std::size(nativeMethods));
+    env->DeleteLocalRef(nativeClass);
+    if (registered != JNI_OK) {
+        nativeLog(LogLevel::Error, "[-] Failed to register natives");
+        return JNI_ERR;
+    }
+    return JNI_VERSION_1_8;
+}
+
+extern "C" JNIEXPORT void JNICALL
+JNI_OnUnload(JavaVM *vm, void *) {
+    // Threads first, so the sweeper cannot turn global hook delivery back on.
+    stopFirstLoadSweeper();
+    stopRedefineWorker();
+    stopMetricsExporter();
+    JNIEnv *env = nullptr;
+    if (vm->GetEnv(reinterpret_cast<void **>(&env), JNI_VERSION_1_8) != JNI_OK) env = nullptr;
+    // No callback may run into the library once it is gone. Dropping the
+    // callbacks also covers hooks still enabled for a single thread.
+    if (jvmti) {
+        jvmti->SetEventNotificationMode(JVMTI_DISABLE, JVMTI_EVENT_CLASS_FILE_LOAD_HOOK, nullptr);
+        if (env) closeLoadedClassIndex(env, jvmti);
+        jvmti->SetEventCallbacks(nullptr, 0);
+    }
+    closeEventRecorder();
+    stopNativeLog();
+    if (!env) return;
+    env->DeleteGlobalRef(classClass);
+    env->DeleteGlobalRef(optionalClass);
+    env->DeleteGlobalRef(stringClass);
+    classClass = nullptr;
+    optionalClass = nullptr;
+    stringClass = nullptr;
+}
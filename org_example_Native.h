@@ -7,6 +7,32 @@
 #ifdef __cplusplus
 extern "C" {
 #endif
+#undef org_example_Native_PROFILE_REDEFINE_ONLY
+#define org_example_Native_PROFILE_REDEFINE_ONLY 0L
+#undef org_example_Native_PROFILE_RETRANSFORM
+#define org_example_Native_PROFILE_RETRANSFORM 1L
+#undef org_example_Native_PROFILE_PROFILING
+#define org_example_Native_PROFILE_PROFILING 2L
+#undef org_example_Native_PROFILE_HEAP_ANALYSIS
+#define org_example_Native_PROFILE_HEAP_ANALYSIS 3L
+#undef org_example_Native_STATUS_UNCHANGED
+#define org_example_Native_STATUS_UNCHANGED -1L
+#undef org_example_Native_STATUS_UNKNOWN_HANDLE
+#define org_example_Native_STATUS_UNKNOWN_HANDLE -2L
+#undef org_example_Native_LIFECYCLE_ONE_SHOT
+#define org_example_Native_LIFECYCLE_ONE_SHOT 0L
+#undef org_example_Native_LIFECYCLE_STICKY
+#define org_example_Native_LIFECYCLE_STICKY 1L
+#undef org_example_Native_LOG_DEBUG
+#define org_example_Native_LOG_DEBUG 0L
+#undef org_example_Native_LOG_INFO
+#define org_example_Native_LOG_INFO 1L
+#undef org_example_Native_LOG_WARN
+#define org_example_Native_LOG_WARN 2L
+#undef org_example_Native_LOG_ERROR
+#define org_example_Native_LOG_ERROR 3L
+#undef org_example_Native_LOG_OFF
+#define org_example_Native_LOG_OFF 4L
 /*
  * Class:     org_example_Native
  * Method:    redefineClass
@@ -31,6 +57,294 @@ JNIEXPORT void JNICALL Java_org_example_Native_retransformClass
 JNIEXPORT jobject JNICALL Java_org_example_Native_accessClass
   (JNIEnv *, jclass, jstring);
 
+/*
+ * Class:     org_example_Native
+ * Method:    requestCapabilityProfile
+ * Signature: (I)Z
+ */
+JNIEXPORT jboolean JNICALL Java_org_example_Native_requestCapabilityProfile
+  (JNIEnv *, jclass, jint);
+
+/*
+ * Class:     org_example_Native
+ * Method:    getCapabilityProfiles
+ * Signature: ()I
+ */
+JNIEXPORT jint JNICALL Java_org_example_Native_getCapabilityProfiles
+  (JNIEnv *, jclass);
+
+/*
+ * Class:     org_example_Native
+ * Method:    retransformClassDirect
+ * Signature: ([Ljava/lang/Class;[Ljava/nio/ByteBuffer;)V
+ */
+JNIEXPORT void JNICALL Java_org_example_Native_retransformClassDirect
+  (JNIEnv *, jclass, jobjectArray, jobjectArray);
+
+/*
+ * Class:     org_example_Native
+ * Method:    retransformClassAddress
+ * Signature: ([Ljava/lang/Class;[J[I)V
+ */
+JNIEXPORT void JNICALL Java_org_example_Native_retransformClassAddress
+  (JNIEnv *, jclass, jobjectArray, jlongArray, jintArray);
+
+/*
+ * Class:     org_example_Native
+ * Method:    redefineClassDirect
+ * Signature: ([Ljava/lang/Class;[Ljava/nio/ByteBuffer;)V
+ */
+JNIEXPORT void JNICALL Java_org_example_Native_redefineClassDirect
+  (JNIEnv *, jclass, jobjectArray, jobjectArray);
+
+/*
+ * Class:     org_example_Native
+ * Method:    redefineClassAddress
+ * Signature: ([Ljava/lang/Class;[J[I)V
+ */
+JNIEXPORT void JNICALL Java_org_example_Native_redefineClassAddress
+  (JNIEnv *, jclass, jobjectArray, jlongArray, jintArray);
+
+/*
+ * Class:     org_example_Native
+ * Method:    redefineClassBudgeted
+ * Signature: ([Ljava/lang/Class;[[BI[I)[J
+ */
+JNIEXPORT jlongArray JNICALL Java_org_example_Native_redefineClassBudgeted
+  (JNIEnv *, jclass, jobjectArray, jobjectArray, jint, jintArray);
+
+/*
+ * Class:     org_example_Native
+ * Method:    retransformClassBudgeted
+ * Signature: ([Ljava/lang/Class;[[BI[I)[J
+ */
+JNIEXPORT jlongArray JNICALL Java_org_example_Native_retransformClassBudgeted
+  (JNIEnv *, jclass, jobjectArray, jobjectArray, jint, jintArray);
+
+/*
+ * Class:     org_example_Native
+ * Method:    redefineClassAsync
+ * Signature: ([Ljava/lang/Class;[[B)J
+ */
+JNIEXPORT jlong JNICALL Java_org_example_Native_redefineClassAsync
+  (JNIEnv *, jclass, jobjectArray, jobjectArray);
+
+/*
+ * Class:     org_example_Native
+ * Method:    awaitRedefine
+ * Signature: (JJ)[I
+ */
+JNIEXPORT jintArray JNICALL Java_org_example_Native_awaitRedefine
+  (JNIEnv *, jclass, jlong, jlong);
+
+/*
+ * Class:     org_example_Native
+ * Method:    getRedefineWorkerStats
+ * Signature: ()[J
+ */
+JNIEXPORT jlongArray JNICALL Java_org_example_Native_getRedefineWorkerStats
+  (JNIEnv *, jclass);
+
+/*
+ * Class:     org_example_Native
+ * Method:    redefineClassCoalesced
+ * Signature: ([Ljava/lang/Class;[[B)[I
+ */
+JNIEXPORT jintArray JNICALL Java_org_example_Native_redefineClassCoalesced
+  (JNIEnv *, jclass, jobjectArray, jobjectArray);
+
+/*
+ * Class:     org_example_Native
+ * Method:    setRedefineCoalescing
+ * Signature: (II)V
+ */
+JNIEXPORT void JNICALL Java_org_example_Native_setRedefineCoalescing
+  (JNIEnv *, jclass, jint, jint);
+
+/*
+ * Class:     org_example_Native
+ * Method:    redefineChangedClasses
+ * Signature: ([Ljava/lang/Class;[[B)[I
+ */
+JNIEXPORT jintArray JNICALL Java_org_example_Native_redefineChangedClasses
+  (JNIEnv *, jclass, jobjectArray, jobjectArray);
+
+/*
+ * Class:     org_example_Native
+ * Method:    stageClass
+ * Signature: (Ljava/lang/Class;[B)V
+ */
+JNIEXPORT void JNICALL Java_org_example_Native_stageClass
+  (JNIEnv *, jclass, jclass, jbyteArray);
+
+/*
+ * Class:     org_example_Native
+ * Method:    unstageClass
+ * Signature: (Ljava/lang/Class;)V
+ */
+JNIEXPORT void JNICALL Java_org_example_Native_unstageClass
+  (JNIEnv *, jclass, jclass);
+
+/*
+ * Class:     org_example_Native
+ * Method:    commitStaged
+ * Signature: ()I
+ */
+JNIEXPORT jint JNICALL Java_org_example_Native_commitStaged
+  (JNIEnv *, jclass);
+
+/*
+ * Class:     org_example_Native
+ * Method:    accessClasses
+ * Signature: ([Ljava/lang/String;)[Ljava/lang/Class;
+ */
+JNIEXPORT jobjectArray JNICALL Java_org_example_Native_accessClasses
+  (JNIEnv *, jclass, jobjectArray);
+
+/*
+ * Class:     org_example_Native
+ * Method:    findLoadedClasses
+ * Signature: (Ljava/lang/String;)[Ljava/lang/Class;
+ */
+JNIEXPORT jobjectArray JNICALL Java_org_example_Native_findLoadedClasses
+  (JNIEnv *, jclass, jstring);
+
+/*
+ * Class:     org_example_Native
+ * Method:    findLoadedClassesByPrefix
+ * Signature: (Ljava/lang/String;)[Ljava/lang/Class;
+ */
+JNIEXPORT jobjectArray JNICALL Java_org_example_Native_findLoadedClassesByPrefix
+  (JNIEnv *, jclass, jstring);
+
+/*
+ * Class:     org_example_Native
+ * Method:    findLoadedClassesByLoader
+ * Signature: (Ljava/lang/ClassLoader;)[Ljava/lang/Class;
+ */
+JNIEXPORT jobjectArray JNICALL Java_org_example_Native_findLoadedClassesByLoader
+  (JNIEnv *, jclass, jobject);
+
+/*
+ * Class:     org_example_Native
+ * Method:    closeLoadedClassIndex
+ * Signature: ()V
+ */
+JNIEXPORT void JNICALL Java_org_example_Native_closeLoadedClassIndex
+  (JNIEnv *, jclass);
+
+/*
+ * Class:     org_example_Native
+ * Method:    stageClassAnyLoader
+ * Signature: (Ljava/lang/Class;[B)V
+ */
+JNIEXPORT void JNICALL Java_org_example_Native_stageClassAnyLoader
+  (JNIEnv *, jclass, jclass, jbyteArray);
+
+/*
+ * Class:     org_example_Native
+ * Method:    redefineByName
+ * Signature: ([Ljava/lang/String;[[B[Ljava/lang/ClassLoader;)[I
+ */
+JNIEXPORT jintArray JNICALL Java_org_example_Native_redefineByName
+  (JNIEnv *, jclass, jobjectArray, jobjectArray, jobjectArray);
+
+/*
+ * Class:     org_example_Native
+ * Method:    defineOnFirstLoad
+ * Signature: (Ljava/lang/String;[BLjava/lang/ClassLoader;Z)V
+ */
+JNIEXPORT void JNICALL Java_org_example_Native_defineOnFirstLoad
+  (JNIEnv *, jclass, jstring, jbyteArray, jobject, jboolean);
+
+/*
+ * Class:     org_example_Native
+ * Method:    getUnfiredFirstLoads
+ * Signature: ()[Ljava/lang/String;
+ */
+JNIEXPORT jobjectArray JNICALL Java_org_example_Native_getUnfiredFirstLoads
+  (JNIEnv *, jclass);
+
+/*
+ * Class:     org_example_Native
+ * Method:    clearFirstLoads
+ * Signature: ()[Ljava/lang/String;
+ */
+JNIEXPORT jobjectArray JNICALL Java_org_example_Native_clearFirstLoads
+  (JNIEnv *, jclass);
+
+/*
+ * Class:     org_example_Native
+ * Method:    stageClassWithMode
+ * Signature: (Ljava/lang/Class;[BI)V
+ */
+JNIEXPORT void JNICALL Java_org_example_Native_stageClassWithMode
+  (JNIEnv *, jclass, jclass, jbyteArray, jint);
+
+/*
+ * Class:     org_example_Native
+ * Method:    setStickyBudget
+ * Signature: (J)V
+ */
+JNIEXPORT void JNICALL Java_org_example_Native_setStickyBudget
+  (JNIEnv *, jclass, jlong);
+
+/*
+ * Class:     org_example_Native
+ * Method:    getStagingMemoryStats
+ * Signature: ()[J
+ */
+JNIEXPORT jlongArray JNICALL Java_org_example_Native_getStagingMemoryStats
+  (JNIEnv *, jclass);
+
+/*
+ * Class:     org_example_Native
+ * Method:    setLogLevel
+ * Signature: (I)V
+ */
+JNIEXPORT void JNICALL Java_org_example_Native_setLogLevel
+  (JNIEnv *, jclass, jint);
+
+/*
+ * Class:     org_example_Native
+ * Method:    getLogStats
+ * Signature: ()[J
+ */
+JNIEXPORT jlongArray JNICALL Java_org_example_Native_getLogStats
+  (JNIEnv *, jclass);
+
+/*
+ * Class:     org_example_Native
+ * Method:    getStats
+ * Signature: ()[J
+ */
+JNIEXPORT jlongArray JNICALL Java_org_example_Native_getStats
+  (JNIEnv *, jclass);
+
+/*
+ * Class:     org_example_Native
+ * Method:    setStatsExporter
+ * Signature: (Ljava/lang/String;J)V
+ */
+JNIEXPORT void JNICALL Java_org_example_Native_setStatsExporter
+  (JNIEnv *, jclass, jstring, jlong);
+
+/*
+ * Class:     org_example_Native
+ * Method:    startEventRecorder
+ * Signature: (Ljava/lang/String;I)Z
+ */
+JNIEXPORT jboolean JNICALL Java_org_example_Native_startEventRecorder
+  (JNIEnv *, jclass, jstring, jint);
+
+/*
+ * Class:     org_example_Native
+ * Method:    stopEventRecorder
+ * Signature: ()V
+ */
+JNIEXPORT void JNICALL Java_org_example_Native_stopEventRecorder
+  (JNIEnv *, jclass);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,74 @@
+#include "pause_budget.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+// Never grow a chunk by more than this factor over the previous one, so a
+// cost estimate taken from small chunks cannot overshoot the budget by much.
+static constexpr std::size_t maxChunkGrowth = 4;
+
+static std::vector<std::vector<std::size_t> > groupUnits(const std::size_t count, const std::span<const int> groups) {
+    std::vector<std::vector<std::size_t> > units;
+    std::unordered_map<int, std::size_t> unitOfGroup;
+    for (std::size_t i = 0; i < count; ++i) {
+        const int group = i < groups.size() ? groups[i] : -1;
+        if (group < 0) {
+            units.push_back({i});
+            continue;
+        }
+        auto [it, inserted] = unitOfGroup.try_emplace(group, units.size());
+        if (inserted) units.emplace_back();
+        units[it->second].push_back(i);
+    }
+    return units;
+}
+
+std::vector<PauseBudgetChunk> runWithinPauseBudget(
+    const std::span<const std::size_t> classBytes,
+    const std::span<const int> groups,
+    const std::chrono::nanoseconds budget,
+    const std::function<int(std::span<const std::size_t> indices)> &apply) {
+    const auto units = groupUnits(classBytes.size(), groups);
+    std::vector<std::size_t> unitBytes(units.size());
+    for (std::size_t u = 0; u < units.size(); ++u) {
+        for (const std::size_t i: units[u]) unitBytes[u] += classBytes[i];
+    }
+
+    // Clamped, like the limit below, so no double out of size_t's range is
+    // ever converted to it.
+    const double budgetNanos = static_cast<double>(std::max<std::int64_t>(budget.count(), 0));
+    std::vector<PauseBudgetChunk> chunks;
+    std::vector<std::size_t> indices;
+    double nanosPerByte = 0;
+    std::size_t previousBytes = 0;
+
+    for (std::size_t next = 0; next < units.size();) {
+        // Until a pause has been measured, probe with a single unit.
+        std::size_t limit = 0;
+        if (nanosPerByte > 0) {
+            const std::size_t growthLimit = std::max<std::size_t>(previousBytes, 1) * maxChunkGrowth;
+            const double budgetBytes = budgetNanos / nanosPerByte;
+            limit = budgetBytes < static_cast<double>(growthLimit) ? static_cast<std::size_t>(budgetBytes) : growthLimit;
+        }
+
+        indices.clear();
+        std::size_t bytes = 0;
+        do {
+            indices.insert(indices.end(), units[next].begin(), units[next].end());
+            bytes += unitBytes[next++];
+        } while (next < units.size() && bytes + unitBytes[next] <= limit);
+
+        const auto start = std::chrono::steady_clock::now();
+        const int error = apply(indices);
+        const auto pause = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start);
+
+        chunks.push_back({indices.size(), pause.count(), error, indices});
+        if (error != 0) break;
+
+        const double observed = static_cast<double>(pause.count()) / static_cast<double>(std::max<std::size_t>(bytes, 1));
+        nanosPerByte = nanosPerByte > 0 ? (nanosPerByte + observed) / 2 : observed;
+        previousBytes = bytes;
+    }
+    return chunks;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <vector>
+
+struct PauseBudgetChunk {
+    std::size_t classCount;
+    std::int64_t pauseNanos;
+    int error;
+    // Positions in classBytes of the classes passed to this chunk's apply().
+    std::vector<std::size_t> indices;
+};
+
+// Applies a batch of classes in chunks sized so that each apply() call, i.e.
+// each safepoint pause, stays within budget. Classes sharing a group id are
+// always applied in the same chunk; a negative id means the class has no
+// dependencies. Chunk sizes adapt to a per-byte cost measured from the
+// previous calls. Chunks follow the order in which groups first appear, and
+// the run stops at the first chunk whose apply() returns a non-zero error.
+// A budget of zero or less applies one group per chunk.
+std::vector<PauseBudgetChunk> runWithinPauseBudget(
+    std::span<const std::size_t> classBytes,
+    std::span<const int> groups,
+    std::chrono::nanoseconds budget,
+    const std::function<int(std::span<const std::size_t> indices)> &apply);
@@ -0,0 +1,89 @@
+#include "perfect_hash.h"
+
+#include <algorithm>
+
+// Average keys per bucket. Larger buckets mean a smaller pilot table but a
+// longer search for the first, fullest buckets.
+static constexpr std::size_t keysPerBucket = 3;
+static constexpr std::uint32_t maxPilot = 1u << 24;
+
+static std::uint64_t remix(std::uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    return x ^ (x >> 33);
+}
+
+// Maps the upper 32 bits of x onto [0, n) without a division.
+static std::size_t fastRange(const std::uint64_t x, const std::size_t n) {
+    return static_cast<std::size_t>((x >> 32) * static_cast<std::uint64_t>(n) >> 32);
+}
+
+PerfectHashIndex::PerfectHashIndex(std::pmr::memory_resource *resource) : pilots_(resource) {
+}
+
+std::size_t PerfectHashIndex::bucketOf(const std::uint64_t hash) const {
+    return fastRange(hash, pilots_.size());
+}
+
+std::size_t PerfectHashIndex::position(const std::uint64_t hash, const std::uint32_t pilot) const {
+    return fastRange(remix(hash ^ pilot * 0x9e3779b97f4a7c15ull), size_);
+}
+
+std::size_t PerfectHashIndex::slot(const std::uint64_t hash) const {
+    return position(hash, pilots_[bucketOf(hash)]);
+}
+
+bool PerfectHashIndex::build(const std::span<const std::uint64_t> hashes, std::vector<std::uint32_t> &slots) {
+    size_ = hashes.size();
+    pilots_.assign(size_ == 0 ? 0 : size_ / keysPerBucket + 1, 0);
+    slots.assign(size_, 0);
+    if (size_ == 0) return true;
+
+    // Counting sort of the keys by bucket.
+    std::vector<std::uint32_t> bucketStart(pilots_.size() + 1);
+    for (const std::uint64_t hash: hashes) bucketStart[bucketOf(hash) + 1]++;
+    for (std::size_t b = 0; b < pilots_.size(); ++b) bucketStart[b + 1] += bucketStart[b];
+    std::vector<std::uint32_t> keys(size_);
+    std::vector<std::uint32_t> fill(bucketStart.begin(), bucketStart.end() - 1);
+    for (std::uint32_t k = 0; k < size_; ++k) keys[fill[bucketOf(hashes[k])]++] = k;
+
+    std::vector<std::uint32_t> order(pilots_.size());
+    for (std::uint32_t b = 0; b < order.size(); ++b) order[b] = b;
+    std::ranges::stable_sort(order, std::greater{}, [&](const std::uint32_t b) {
+        return bucketStart[b + 1] - bucketStart[b];
+    });
+
+    std::vector<bool> taken(size_);
+    std::vector<std::size_t> placed;
+    for (const std::uint32_t b: order) {
+        const std::span<const std::uint32_t> members(keys.data() + bucketStart[b], bucketStart[b + 1] - bucketStart[b]);
+        if (members.empty()) break;
+
+        for (std::size_t i = 0; i < members.size(); ++i) {
+            for (std::size_t j = i + 1; j < members.size(); ++j) {
+                if (hashes[members[i]] == hashes[members[j]]) return false;
+            }
+        }
+
+        std::uint32_t pilot = 0;
+        for (;; ++pilot) {
+            if (pilot == maxPilot) return false;
+            placed.clear();
+            for (const std::uint32_t k: members) {
+                const std::size_t p = position(hashes[k], pilot);
+                if (taken[p] || std::ranges::find(placed, p) != placed.end()) break;
+                placed.push_back(p);
+            }
+            if (placed.size() == members.size()) break;
+        }
+
+        pilots_[b] = pilot;
+        for (std::size_t i = 0; i < members.size(); ++i) {
+            taken[placed[i]] = true;
+            slots[members[i]] = static_cast<std::uint32_t>(placed[i]);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <span>
+#include <vector>
+
+// Minimal perfect hash over a fixed set of 64-bit key hashes, built by hash
+// and displace: keys fall into small buckets, and each bucket stores the
+// first pilot value that sends all of its keys to still-free slots. A lookup
+// is one pilot load plus arithmetic, and the result is always a slot in
+// [0, size()); callers confirm the key stored there.
+class PerfectHashIndex {
+public:
+    explicit PerfectHashIndex(std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+
+    // Fills slots[i] with the slot of hashes[i]. Fails when two keys share a
+    // 64-bit hash, which no pilot can separate, or when some bucket's pilot
+    // search reaches maxPilot without finding free slots for all its keys.
+    bool build(std::span<const std::uint64_t> hashes, std::vector<std::uint32_t> &slots);
+
+    std::size_t slot(std::uint64_t hash) const;
+
+    std::size_t size() const { return size_; }
+
+    std::size_t memoryBytes() const { return pilots_.size() * sizeof(std::uint32_t); }
+
+private:
+    std::size_t bucketOf(std::uint64_t hash) const;
+
+    std::size_t position(std::uint64_t hash, std::uint32_t pilot) const;
+
+    std::pmr::vector<std::uint32_t> pilots_;
+    std::size_t size_ = 0;
+};
@@ -0,0 +1,334 @@
+#include "redefine_worker.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+#include "event_recorder.h"
+#include "installed_hashes.h"
+#include "native_log.h"
+#include "native_metrics.h"
+
+using WorkerClock = std::chrono::steady_clock;
+
+struct RedefineJob {
+    std::uint64_t handle;
+    std::vector<jclass> classes;
+    std::vector<jbyteArray> arrays;
+    WorkerClock::time_point submitted;
+};
+
+struct RedefineResult {
+    bool done = false;
+    std::vector<jint> status;
+};
+
+static std::mutex workerMutex;
+static std::condition_variable jobQueued;
+static std::condition_variable jobFinished;
+static std::deque<RedefineJob> jobQueue;
+static std::unordered_map<std::uint64_t, RedefineResult> jobResults;
+// Handles in the order their jobs finished; may still list awaited ones.
+static std::deque<std::uint64_t> finishedHandles;
+static std::uint64_t nextHandle = 1;
+static std::thread *worker = nullptr;
+// False again once a worker that failed to attach has given up.
+static bool workerStarted = false;
+static bool workerStopping = false;
+static RedefineWorkerStats stats{};
+static std::chrono::milliseconds coalesceWindow{0};
+static std::size_t coalesceMaxBatch = 0;
+
+// Publishes a job's outcome and expires the oldest results nobody awaited.
+// Caller holds workerMutex.
+static void finishJob(const std::uint64_t handle, std::vector<jint> status) {
+    const auto it = jobResults.find(handle);
+    if (it == jobResults.end()) return;
+    it->second.done = true;
+    it->second.status = std::move(status);
+    finishedHandles.push_back(handle);
+    while (finishedHandles.size() > maxUnawaitedRedefineResults) {
+        jobResults.erase(finishedHandles.front());
+        finishedHandles.pop_front();
+    }
+}
+
+static std::int64_t elapsedNanos(const WorkerClock::time_point from, const WorkerClock::time_point to) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count();
+}
+
+struct BatchOutcome {
+    std::vector<std::vector<jint> > status;
+    std::int64_t superseded = 0;
+    std::int64_t redefineCalls = 0;
+    jvmtiError error = JVMTI_ERROR_NONE;
+};
+
+// Redefines every class of every job in one RedefineClasses call. When the
+// same class appears more than once, only the bytes submitted last are used;
+// each job is told the outcome for all of its classes. The jobs keep their
+// references.
+static BatchOutcome redefineTogether(JNIEnv *env, jvmtiEnv *jvmti, const std::span<const RedefineJob> batch) {
+    struct Source {
+        std::size_t job;
+        std::size_t index;
+    };
+
+    BatchOutcome outcome;
+    auto &status = outcome.status;
+    std::vector<Source> latest;
+    std::unordered_multimap<jint, std::size_t> byHash;
+    for (std::size_t j = 0; j < batch.size(); ++j) {
+        const RedefineJob &job = batch[j];
+        status.emplace_back(job.classes.size(), JVMTI_ERROR_NULL_POINTER);
+        for (std::size_t i = 0; i < job.classes.size(); ++i) {
+            if (!job.classes[i] || !job.arrays[i]) continue;
+
+            jint hash = 0;
+            jvmti->GetObjectHashCode(job.classes[i], &hash);
+            auto [first, last] = byHash.equal_range(hash);
+            auto same = std::find_if(first, last, [&](const auto &entry) {
+                const Source &seen = latest[entry.second];
+                return env->IsSameObject(batch[seen.job].classes[seen.index], job.classes[i]);
+            });
+            if (same != last) {
+                latest[same->second] = {j, i};
+                outcome.superseded++;
+            } else {
+                byHash.emplace(hash, latest.size());
+                latest.push_back({j, i});
+            }
+        }
+    }
+
+    std::vector<jvmtiClassDefinition> defs;
+    std::vector<jbyte *> ptrs;
+    std::size_t bytes = 0;
+    for (const Source &source: latest) {
+        jbyteArray arr = batch[source.job].arrays[source.index];
+        jbyte *data = env->GetByteArrayElements(arr, nullptr);
+        defs.push_back({batch[source.job].classes[source.index], env->GetArrayLength(arr),
+                        reinterpret_cast<unsigned char *>(data)});
+        ptrs.push_back(data);
+        bytes += defs.back().class_byte_count;
+    }
+
+    jvmtiError err = JVMTI_ERROR_NONE;
+    if (!defs.empty()) {
+        const std::uint64_t started = metricTicks();
+        err = recordedRedefineClasses(jvmti, static_cast<jint>(defs.size()), defs.data());
+        recordApplyMetric(MetricOp::Redefine, err, defs.size(), bytes, started);
+    }
+    outcome.redefineCalls = !defs.empty();
+    outcome.error = err;
+    if (outcome.redefineCalls && err == JVMTI_ERROR_NONE) recordInstalledDefinitions(env, jvmti, defs);
+
+    for (std::size_t k = 0; k < latest.size(); ++k) {
+        env->ReleaseByteArrayElements(batch[latest[k].job].arrays[latest[k].index], ptrs[k], JNI_ABORT);
+    }
+    for (std::size_t j = 0; j < batch.size(); ++j) {
+        const RedefineJob &job = batch[j];
+        for (std::size_t i = 0; i < job.classes.size(); ++i) {
+            if (job.classes[i] && job.arrays[i]) status[j][i] = err;
+        }
+    }
+    return outcome;
+}
+
+// Runs a batch merged, then releases its references. One bad class fails a
+// whole RedefineClasses call, so a failed merge is retried job by job, in
+// submission order, and each job gets the outcome of its own classes.
+static BatchOutcome runBatch(JNIEnv *env, jvmtiEnv *jvmti, const std::vector<RedefineJob> &batch) {
+    BatchOutcome outcome = redefineTogether(env, jvmti, batch);
+    if (batch.size() > 1 && outcome.error != JVMTI_ERROR_NONE) {
+        outcome.superseded = 0;
+        for (std::size_t j = 0; j < batch.size(); ++j) {
+            BatchOutcome alone = redefineTogether(env, jvmti, std::span(batch).subspan(j, 1));
+            outcome.status[j] = std::move(alone.status.front());
+            outcome.superseded += alone.superseded;
+            outcome.redefineCalls += alone.redefineCalls;
+        }
+    }
+
+    for (const RedefineJob &job: batch) {
+        for (std::size_t i = 0; i < job.classes.size(); ++i) {
+            if (job.classes[i]) env->DeleteGlobalRef(job.classes[i]);
+            if (job.arrays[i]) env->DeleteGlobalRef(job.arrays[i]);
+        }
+    }
+    return outcome;
+}
+
+// Takes the next job off the queue and, with coalescing on, keeps gathering
+// jobs until the window since the first one closes or maxBatch classes are in.
+// Returns no jobs once the worker is being stopped.
+static std::vector<RedefineJob> takeBatch(std::unique_lock<std::mutex> &lock) {
+    std::vector<RedefineJob> batch;
+    std::size_t classCount = 0;
+    const auto take = [&] {
+        classCount += jobQueue.front().classes.size();
+        batch.push_back(std::move(jobQueue.front()));
+        jobQueue.pop_front();
+    };
+
+    const auto ready = [] { return !jobQueue.empty() || workerStopping; };
+    jobQueued.wait(lock, ready);
+    if (workerStopping) return batch;
+    take();
+    if (coalesceWindow.count() > 0) {
+        const auto deadline = batch.front().submitted + coalesceWindow;
+        while (classCount < coalesceMaxBatch && !workerStopping) {
+            if (!jobQueue.empty()) {
+                take();
+            } else if (!jobQueued.wait_until(lock, deadline, ready)) {
+                break;
+            }
+        }
+    }
+    stats.queueDepth = static_cast<std::int64_t>(jobQueue.size());
+    return batch;
+}
+
+static void workerLoop(JavaVM *vm, jvmtiEnv *jvmti) {
+    JNIEnv *env = nullptr;
+    JavaVMAttachArgs args{JNI_VERSION_1_8, const_cast<char *>("JNILibrary redefine worker"), nullptr};
+    if (vm->AttachCurrentThreadAsDaemon(reinterpret_cast<void **>(&env), &args) != JNI_OK) {
+        nativeLog(LogLevel::Error, "[-] Failed to attach redefine worker");
+        std::lock_guard lock(workerMutex);
+        for (const RedefineJob &job: jobQueue) {
+            finishJob(job.handle, std::vector<jint>(job.classes.size(), JVMTI_ERROR_UNATTACHED_THREAD));
+        }
+        jobQueue.clear();
+        stats.queueDepth = 0;
+        workerStarted = false;
+        jobFinished.notify_all();
+        return;
+    }
+
+    std::unique_lock lock(workerMutex);
+    while (true) {
+        std::vector<RedefineJob> batch = takeBatch(lock);
+        if (batch.empty()) break;
+        lock.unlock();
+
+        const auto started = WorkerClock::now();
+        BatchOutcome outcome = runBatch(env, jvmti, batch);
+        const auto finished = WorkerClock::now();
+
+        lock.lock();
+        stats.redefineCalls += outcome.redefineCalls;
+        stats.supersededClasses += outcome.superseded;
+        stats.lastServiceNanos = elapsedNanos(started, finished);
+        stats.maxServiceNanos = std::max(stats.maxServiceNanos, stats.lastServiceNanos);
+        for (std::size_t j = 0; j < batch.size(); ++j) {
+            stats.completed++;
+            stats.lastQueueNanos = elapsedNanos(batch[j].submitted, started);
+            stats.maxQueueNanos = std::max(stats.maxQueueNanos, stats.lastQueueNanos);
+            finishJob(batch[j].handle, std::move(outcome.status[j]));
+        }
+        jobFinished.notify_all();
+    }
+
+    for (const RedefineJob &job: jobQueue) {
+        for (std::size_t i = 0; i < job.classes.size(); ++i) {
+            if (job.classes[i]) env->DeleteGlobalRef(job.classes[i]);
+            if (job.arrays[i]) env->DeleteGlobalRef(job.arrays[i]);
+        }
+        finishJob(job.handle, std::vector<jint>(job.classes.size(), JVMTI_ERROR_WRONG_PHASE));
+    }
+    jobQueue.clear();
+    stats.queueDepth = 0;
+    jobFinished.notify_all();
+    lock.unlock();
+    vm->DetachCurrentThread();
+}
+
+std::uint64_t submitRedefineJob(JNIEnv *env, jvmtiEnv *jvmti, jobjectArray classes, jobjectArray bytesArray) {
+    JavaVM *vm = nullptr;
+    if (env->GetJavaVM(&vm) != JNI_OK || !vm) return 0;
+
+    const jsize count = env->GetArrayLength(classes);
+    RedefineJob job{0, std::vector<jclass>(count), std::vector<jbyteArray>(count), WorkerClock::now()};
+    for (jsize i = 0; i < count; ++i) {
+        jobject cls = env->GetObjectArrayElement(classes, i);
+        jobject arr = env->GetObjectArrayElement(bytesArray, i);
+        if (cls) job.classes[i] = static_cast<jclass>(env->NewGlobalRef(cls));
+        if (arr) job.arrays[i] = static_cast<jbyteArray>(env->NewGlobalRef(arr));
+        env->DeleteLocalRef(cls);
+        env->DeleteLocalRef(arr);
+    }
+
+    std::lock_guard lock(workerMutex);
+    if (workerStopping) {
+        for (std::size_t i = 0; i < job.classes.size(); ++i) {
+            if (job.classes[i]) env->DeleteGlobalRef(job.classes[i]);
+            if (job.arrays[i]) env->DeleteGlobalRef(job.arrays[i]);
+        }
+        return 0;
+    }
+    if (!workerStarted) {
+        // A worker that failed to attach has already returned.
+        if (worker) worker->join();
+        delete worker;
+        workerStarted = true;
+        worker = new std::thread(workerLoop, vm, jvmti);
+    }
+    job.handle = nextHandle++;
+    const std::uint64_t handle = job.handle;
+    jobResults.emplace(handle, RedefineResult{});
+    jobQueue.push_back(std::move(job));
+    stats.submitted++;
+    stats.queueDepth = static_cast<std::int64_t>(jobQueue.size());
+    jobQueued.notify_one();
+    return handle;
+}
+
+RedefineJobState awaitRedefineJob(const std::uint64_t handle, const std::chrono::milliseconds timeout,
+                                  std::vector<jint> &status) {
+    std::unique_lock lock(workerMutex);
+    if (!jobFinished.wait_for(lock, timeout, [&] {
+        const auto it = jobResults.find(handle);
+        return it == jobResults.end() || it->second.done;
+    })) {
+        return RedefineJobState::Running;
+    }
+
+    const auto it = jobResults.find(handle);
+    if (it == jobResults.end()) return RedefineJobState::Unknown;
+    status = std::move(it->second.status);
+    jobResults.erase(it);
+    if (!finishedHandles.empty() && finishedHandles.front() == handle) finishedHandles.pop_front();
+    return RedefineJobState::Done;
+}
+
+void stopRedefineWorker() {
+    std::thread *stopped = nullptr;
+    {
+        std::lock_guard lock(workerMutex);
+        stopped = std::exchange(worker, nullptr);
+        if (!stopped) return;
+        workerStopping = true;
+        jobQueued.notify_all();
+    }
+    stopped->join();
+    delete stopped;
+    std::lock_guard lock(workerMutex);
+    workerStopping = false;
+    workerStarted = false;
+}
+
+void setRedefineCoalescing(const std::chrono::milliseconds window, const std::size_t maxBatch) {
+    std::lock_guard lock(workerMutex);
+    coalesceWindow = std::max(window, std::chrono::milliseconds{0});
+    coalesceMaxBatch = maxBatch;
+}
+
+RedefineWorkerStats redefineWorkerStats() {
+    std::lock_guard lock(workerMutex);
+    return stats;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <jvmti.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct RedefineWorkerStats {
+    std::int64_t queueDepth;
+    std::int64_t submitted;
+    std::int64_t completed;
+    std::int64_t lastQueueNanos;
+    std::int64_t maxQueueNanos;
+    std::int64_t lastServiceNanos;
+    std::int64_t maxServiceNanos;
+    std::int64_t redefineCalls;
+    std::int64_t supersededClasses;
+};
+
+// Queues a RedefineClasses job for the library's daemon worker thread, which
+// is attached to the VM once on first use. The arrays are captured as global
+// references; their bytes are read on the worker. Returns 0 on failure.
+std::uint64_t submitRedefineJob(JNIEnv *env, jvmtiEnv *jvmti, jobjectArray classes, jobjectArray bytesArray);
+
+// Lets the worker finish the batch it is running, fails the jobs still
+// queued with JVMTI_ERROR_WRONG_PHASE, and joins it. The next submit starts
+// a new worker.
+void stopRedefineWorker();
+
+enum class RedefineJobState {
+    Running,
+    Done,
+    // Never issued, already awaited, or expired unawaited.
+    Unknown,
+};
+
+// Waits up to timeout for the job to finish. On completion the per-class
+// jvmtiError codes are moved into status and the handle is released. Only
+// the newest maxUnawaitedRedefineResults finished jobs keep their results;
+// older ones expire, so callers that never await cannot grow the table.
+RedefineJobState awaitRedefineJob(std::uint64_t handle, std::chrono::milliseconds timeout,
+                                  std::vector<jint> &status);
+
+inline constexpr std::size_t maxUnawaitedRedefineResults = 4096;
+
+// With a non-zero window the worker merges queued jobs into one
+// RedefineClasses call: it waits up to window after the oldest job was
+// submitted or until maxBatch classes are gathered, and redefines each class
+// once with the bytes submitted last. If that call fails, the merged jobs are
+// redefined again one by one, so a bad class only fails the job that sent
+// it. A zero window runs jobs one by one.
+void setRedefineCoalescing(std::chrono::milliseconds window, std::size_t maxBatch);
+
+RedefineWorkerStats redefineWorkerStats();
@@ -0,0 +1,223 @@
+#include "staged_classes.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+
+#include "content_hash.h"
+
+struct StagedClass {
+    jclass cls = nullptr;
+    // Latest staged bytes; an applied one-shot entry is erased with them.
+    std::shared_ptr<const std::vector<unsigned char> > bytes;
+    // Applied bytes of a sticky entry, published on StagingChannel::Sticky.
+    // Usually the same buffer as bytes.
+    std::shared_ptr<const std::vector<unsigned char> > sticky;
+    std::shared_ptr<StagedEntryState> state;
+    std::int64_t stagedAtNanos = 0;
+    std::uint64_t hash = 0;
+    std::uint64_t committedHash = 0;
+    StagedLifecycle lifecycle = StagedLifecycle::OneShot;
+    bool committed = false;
+    bool removed = false;
+};
+
+static std::mutex stagedMutex;
+static std::unordered_map<StagedKey, StagedClass, StagedKeyHash> stagedClasses;
+static std::size_t stickyBudget = 0;
+static std::atomic<std::size_t> stickyPublished{0};
+// Set when an edit changed what the sticky channel should hold. Republishing
+// reseals the whole channel and waits out its readers, so edits only mark it
+// and the next commit publishes once.
+static bool stickyDirty = false;
+static StagedMemoryStats counters{};
+
+static std::int64_t nowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool isDirty(const StagedClass &staged) {
+    return staged.removed || !staged.committed || staged.hash != staged.committedHash;
+}
+
+static std::int64_t lastUsedNanos(const StagedClass &staged) {
+    return std::max(staged.stagedAtNanos, staged.state->lastHitNanos.load(std::memory_order_relaxed));
+}
+
+// Evicts sticky entries, least recently substituted first, until the sticky
+// bytes fit the budget. Caller holds stagedMutex and republishes.
+static void enforceStickyBudget() {
+    if (stickyBudget == 0) return;
+    std::size_t held = 0;
+    std::vector<StagedClass *> sticky;
+    for (auto &[key, staged]: stagedClasses) {
+        if (!staged.sticky) continue;
+        held += staged.sticky->size();
+        sticky.push_back(&staged);
+    }
+    if (held <= stickyBudget) return;
+
+    std::ranges::sort(sticky, {}, [](const StagedClass *staged) { return lastUsedNanos(*staged); });
+    for (StagedClass *staged: sticky) {
+        if (held <= stickyBudget) break;
+        const std::size_t size = staged->sticky->size();
+        if (staged->bytes == staged->sticky) staged->bytes.reset();
+        staged->sticky.reset();
+        held -= size;
+        counters.evictedClasses++;
+        counters.evictedBytes += static_cast<std::int64_t>(size);
+    }
+}
+
+// Rebuilds the sticky channel from the entries holding applied sticky bytes.
+// Caller holds stagedMutex.
+static void publishStickyClasses() {
+    enforceStickyBudget();
+    std::unique_ptr<StagingSnapshot> next;
+    std::size_t count = 0;
+    for (const auto &[key, staged]: stagedClasses) {
+        if (!staged.sticky) continue;
+        if (!next) next = std::make_unique<StagingSnapshot>();
+        next->stageInterned(key.name, *staged.sticky, key.loader, key.anyLoader, staged.state);
+        next->ownedBytes.push_back(staged.sticky);
+        count++;
+    }
+    publishStagingSnapshot(std::move(next), StagingChannel::Sticky);
+    stickyPublished.store(count, std::memory_order_relaxed);
+    stickyDirty = false;
+}
+
+void stageClass(JNIEnv *env, jclass cls, const StagedKey &key,
+                std::shared_ptr<const std::vector<unsigned char> > bytes, const StagedLifecycle lifecycle) {
+    const std::uint64_t hash = contentHash(*bytes);
+    std::lock_guard lock(stagedMutex);
+    auto &staged = stagedClasses[key];
+    const bool wasSticky = staged.sticky != nullptr;
+    if (!staged.cls || !env->IsSameObject(staged.cls, cls)) {
+        if (staged.cls) env->DeleteGlobalRef(staged.cls);
+        staged.cls = static_cast<jclass>(env->NewGlobalRef(cls));
+        staged.committed = false;
+        staged.sticky.reset();
+    }
+    staged.bytes = std::move(bytes);
+    staged.hash = hash;
+    staged.removed = false;
+    staged.lifecycle = lifecycle;
+    staged.state = std::make_shared<StagedEntryState>();
+    staged.stagedAtNanos = nowNanos();
+
+    // Bytes already installed become sticky at once; new ones only once a
+    // commit has applied them, the previous sticky bytes serving until then.
+    if (lifecycle == StagedLifecycle::OneShot) {
+        staged.sticky.reset();
+    } else if (!isDirty(staged)) {
+        staged.sticky = staged.bytes;
+    }
+    if (wasSticky || staged.sticky) stickyDirty = true;
+}
+
+void unstageClass(JNIEnv *env, const StagedKey &key) {
+    std::lock_guard lock(stagedMutex);
+    const auto it = stagedClasses.find(key);
+    if (it == stagedClasses.end()) return;
+
+    const bool wasSticky = it->second.sticky != nullptr;
+    if (it->second.committed) {
+        it->second.removed = true;
+        it->second.bytes.reset();
+        it->second.sticky.reset();
+    } else {
+        env->DeleteGlobalRef(it->second.cls);
+        stagedClasses.erase(it);
+    }
+    if (wasSticky) stickyDirty = true;
+}
+
+StagedCommit prepareStagedCommit(JNIEnv *env) {
+    StagedCommit commit;
+    commit.snapshot = std::make_unique<StagingSnapshot>();
+
+    std::lock_guard lock(stagedMutex);
+    // Before the retransform, so an unstaged sticky class is not handed its
+    // sticky bytes again.
+    if (stickyDirty) publishStickyClasses();
+    for (const auto &[key, staged]: stagedClasses) {
+        if (!isDirty(staged)) continue;
+
+        commit.classes.push_back(static_cast<jclass>(env->NewGlobalRef(staged.cls)));
+        commit.committedHashes.emplace_back(key, staged.hash);
+        if (staged.removed) {
+            commit.removed++;
+            continue;
+        }
+        commit.snapshot->stageInterned(key.name, *staged.bytes, key.loader, key.anyLoader, staged.state);
+        commit.snapshot->ownedBytes.push_back(staged.bytes);
+    }
+    return commit;
+}
+
+void finishStagedCommit(JNIEnv *env, const StagedCommit &commit, const bool applied) {
+    for (jclass cls: commit.classes) env->DeleteGlobalRef(cls);
+    if (!applied) return;
+
+    std::lock_guard lock(stagedMutex);
+    bool stickyChanged = false;
+    for (const auto &[key, hash]: commit.committedHashes) {
+        const auto it = stagedClasses.find(key);
+        if (it == stagedClasses.end()) continue;
+
+        StagedClass &staged = it->second;
+        if (staged.removed) {
+            env->DeleteGlobalRef(staged.cls);
+            stagedClasses.erase(it);
+            continue;
+        }
+        staged.committed = true;
+        staged.committedHash = hash;
+        // Restaged since the commit was prepared: the new bytes are pending.
+        if (staged.hash != hash) continue;
+
+        if (staged.lifecycle == StagedLifecycle::Sticky) {
+            staged.sticky = staged.bytes;
+            stickyChanged = true;
+        } else if (staged.state->hits.load(std::memory_order_relaxed) > 0) {
+            // Nothing is left to substitute, so the entry goes as well; holding
+            // its class would pin the class loader.
+            counters.oneShotFreedClasses++;
+            counters.oneShotFreedBytes += static_cast<std::int64_t>(staged.bytes->size());
+            env->DeleteGlobalRef(staged.cls);
+            stagedClasses.erase(it);
+        }
+    }
+    if (stickyChanged) publishStickyClasses();
+}
+
+void setStickyByteBudget(const std::size_t bytes) {
+    std::lock_guard lock(stagedMutex);
+    stickyBudget = bytes;
+    publishStickyClasses();
+}
+
+std::size_t stickyClassCount() {
+    return stickyPublished.load(std::memory_order_relaxed);
+}
+
+StagedMemoryStats stagedMemoryStats() {
+    std::lock_guard lock(stagedMutex);
+    StagedMemoryStats stats = counters;
+    stats.bytesHeld = 0;
+    stats.stickyBytes = 0;
+    stats.stickyClasses = 0;
+    for (const auto &[key, staged]: stagedClasses) {
+        if (staged.bytes) stats.bytesHeld += static_cast<std::int64_t>(staged.bytes->size());
+        if (!staged.sticky) continue;
+        if (staged.sticky != staged.bytes) stats.bytesHeld += static_cast<std::int64_t>(staged.sticky->size());
+        stats.stickyBytes += static_cast<std::int64_t>(staged.sticky->size());
+        stats.stickyClasses++;
+    }
+    stats.stickyBudget = static_cast<std::int64_t>(stickyBudget);
+    return stats;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <jni.h>
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "staging.h"
+
+// Long-lived set of classes staged for retransformation, keyed by interned
+// internal name (see internName()) and canonical loader (see
+// canonicalLoader()); an entry staged for any loader is keyed apart from the
+// exact ones. Entries are added, updated or removed one at a time; a commit only
+// covers entries whose bytes changed, or that were removed, since the last
+// successful commit.
+struct StagedKey {
+    std::string_view name;
+    jweak loader = nullptr;
+    bool anyLoader = false;
+
+    bool operator==(const StagedKey &) const = default;
+};
+
+struct StagedKeyHash {
+    std::size_t operator()(const StagedKey &key) const noexcept {
+        return std::hash<std::string_view>{}(key.name) ^ std::hash<jweak>{}(key.loader) * 31 ^ key.anyLoader;
+    }
+};
+
+// What happens to an entry's bytes once they have been applied. A OneShot
+// entry is dropped, class reference and all, after the hook has substituted
+// its bytes; staging them again retransforms the class again. Sticky bytes stay
+// published on StagingChannel::Sticky and are substituted again whenever the
+// class is retransformed, by this library or by another agent, until they are
+// unstaged or evicted to stay within the sticky budget.
+enum class StagedLifecycle {
+    OneShot = 0,
+    Sticky = 1,
+};
+
+// Edits to sticky entries reach StagingChannel::Sticky when the next commit
+// is prepared, so a bulk edit republishes the channel once.
+void stageClass(JNIEnv *env, jclass cls, const StagedKey &key,
+                std::shared_ptr<const std::vector<unsigned char> > bytes,
+                StagedLifecycle lifecycle = StagedLifecycle::OneShot);
+
+void unstageClass(JNIEnv *env, const StagedKey &key);
+
+struct StagedCommit {
+    // Hook table for the classes that changed; removed classes are absent so
+    // retransforming them restores their original bytes.
+    std::unique_ptr<StagingSnapshot> snapshot;
+    // Global references owned by the commit, released by finishStagedCommit.
+    std::vector<jclass> classes;
+    std::vector<std::pair<StagedKey, std::uint64_t> > committedHashes;
+    std::size_t removed = 0;
+};
+
+StagedCommit prepareStagedCommit(JNIEnv *env);
+
+// Marks the commit's entries clean when applied; otherwise they stay dirty
+// and are retried by the next commit.
+void finishStagedCommit(JNIEnv *env, const StagedCommit &commit, bool applied);
+
+// Caps the bytes held by applied sticky entries; 0 removes the cap. Over the
+// cap, the least recently substituted entries are evicted: their bytes are
+// dropped and the class keeps whatever is installed until it is next
+// retransformed.
+void setStickyByteBudget(std::size_t bytes);
+
+// Number of entries published on StagingChannel::Sticky. Global hook
+// delivery has to be on while it is non-zero.
+std::size_t stickyClassCount();
+
+struct StagedMemoryStats {
+    std::int64_t bytesHeld;
+    std::int64_t stickyBytes;
+    std::int64_t stickyBudget;
+    std::int64_t stickyClasses;
+    std::int64_t evictedClasses;
+    std::int64_t evictedBytes;
+    std::int64_t oneShotFreedClasses;
+    std::int64_t oneShotFreedBytes;
+};
+
+StagedMemoryStats stagedMemoryStats();
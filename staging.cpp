@@ -0,0 +1,274 @@
+#include "staging.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+// Small batches fit in one arena block; large ones size it from the caller's
+// estimate so keys and bytes stay contiguous.
+static constexpr std::size_t minimumArenaBytes = 4096;
+
+static std::uint64_t hashName(const std::string_view name) {
+    std::uint64_t h = 0x9e3779b97f4a7c15ull ^ name.size();
+    const char *p = name.data();
+    std::size_t n = name.size();
+    for (; n >= 8; p += 8, n -= 8) {
+        std::uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        h = (h ^ word) * 0xff51afd7ed558ccdull;
+        h ^= h >> 32;
+    }
+    std::uint64_t tail = 0;
+    memcpy(&tail, p, n);
+    h = (h ^ tail) * 0xc4ceb9fe1a85ec53ull;
+    return h ^ (h >> 29);
+}
+
+StagingKey stagingKey(const std::string_view name) {
+    return {name, hashName(name)};
+}
+
+StagingSnapshot::StagingSnapshot(const std::size_t expectedBytes)
+    : arena(std::max(expectedBytes, minimumArenaBytes)) {
+}
+
+void StagingSnapshot::reserve(const std::size_t classCount) {
+    pending_.reserve(classCount);
+}
+
+void StagingSnapshot::stage(const std::string_view name, const std::span<const unsigned char> bytes, jweak loader,
+                            const bool anyLoader, std::shared_ptr<StagedEntryState> state) {
+    auto *key = static_cast<char *>(arena.allocate(name.size(), alignof(char)));
+    memcpy(key, name.data(), name.size());
+    stageInterned({key, name.size()}, bytes, loader, anyLoader, std::move(state));
+}
+
+void StagingSnapshot::stageInterned(const std::string_view name, const std::span<const unsigned char> bytes,
+                                    jweak loader, const bool anyLoader, std::shared_ptr<StagedEntryState> state) {
+    pending_.push_back({hashName(name), name.data(), bytes.data(), anyLoader ? nullptr : loader,
+                        static_cast<std::uint32_t>(name.size()), static_cast<std::uint32_t>(bytes.size()), 0,
+                        anyLoader ? StagedEntry::anyLoader : 0});
+    states_.push_back(std::move(state));
+}
+
+std::span<unsigned char> StagingSnapshot::allocateBytes(const std::size_t size) {
+    return {static_cast<unsigned char *>(arena.allocate(size, alignof(std::max_align_t))), size};
+}
+
+void StagingSnapshot::seal() {
+    if (pending_.empty()) return;
+
+    // Group entries by name; the stable sort keeps each group in staging
+    // order so the most recent entry for a loader wins.
+    std::vector<std::uint32_t> order(pending_.size());
+    for (std::uint32_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::ranges::stable_sort(order, [&](const std::uint32_t x, const std::uint32_t y) {
+        const StagedEntry &a = pending_[x];
+        const StagedEntry &b = pending_[y];
+        return a.hash != b.hash ? a.hash < b.hash : a.name() < b.name();
+    });
+    const auto sameName = [&](const std::uint32_t x, const std::uint32_t y) {
+        return pending_[x].hash == pending_[y].hash && pending_[x].name() == pending_[y].name();
+    };
+
+    std::vector<std::pair<std::size_t, std::size_t> > groups;
+    for (std::size_t first = 0, last; first < order.size(); first = last) {
+        for (last = first + 1; last < order.size() && sameName(order[first], order[last]); ++last) {
+        }
+        groups.emplace_back(first, last);
+    }
+
+    std::vector<std::uint64_t> hashes(groups.size());
+    std::ranges::transform(groups, hashes.begin(), [&](const auto &group) { return pending_[order[group.first]].hash; });
+    std::vector<std::uint32_t> slots;
+    perfect_ = index_.build(hashes, slots);
+
+    auto *sealed = static_cast<StagedEntry *>(arena.allocate(pending_.size() * sizeof(StagedEntry),
+                                                             alignof(StagedEntry)));
+    if (std::ranges::any_of(states_, [](const auto &state) { return state != nullptr; })) {
+        entryStates_ = static_cast<StagedEntryState **>(arena.allocate(pending_.size() * sizeof(StagedEntryState *),
+                                                                       alignof(StagedEntryState *)));
+    }
+    const auto place = [&](const std::size_t position, const std::uint32_t source) {
+        if (entryStates_) entryStates_[position] = states_[source].get();
+        return std::construct_at(&sealed[position], pending_[source]);
+    };
+
+    heads_ = groups.size();
+    std::size_t used = heads_;
+    for (std::size_t g = 0; g < groups.size(); ++g) {
+        const auto [first, last] = groups[g];
+        const std::size_t head = perfect_ ? slots[g] : g;
+        StagedEntry *tail = place(head, order[last - 1]);
+        const std::size_t chainStart = used;
+        for (std::size_t i = last - 1; i-- > first;) {
+            const StagedEntry &entry = pending_[order[i]];
+            const auto replaced = [&](const StagedEntry &later) {
+                return later.loader == entry.loader && later.flags == entry.flags;
+            };
+            if (replaced(sealed[head]) || std::any_of(sealed + chainStart, sealed + used, replaced)) continue;
+            tail->next = static_cast<std::uint32_t>(used);
+            tail = place(used++, order[i]);
+        }
+    }
+    entries_ = {sealed, used};
+    std::vector<StagedEntry>().swap(pending_);
+}
+
+bool StagingSnapshot::recordHit(const StagedEntry &entry) const {
+    StagedEntryState *state = entryStates_ ? entryStates_[&entry - entries_.data()] : nullptr;
+    if (!state) return true;
+    if (state->singleUse && state->claimed.exchange(true, std::memory_order_acq_rel)) return false;
+    state->hits.fetch_add(1, std::memory_order_relaxed);
+    state->lastHitNanos.store(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                  std::chrono::steady_clock::now().time_since_epoch()).count(),
+                              std::memory_order_relaxed);
+    return true;
+}
+
+const StagedEntry *StagingSnapshot::find(const StagingKey &key) const {
+    if (entries_.empty()) return nullptr;
+    if (perfect_) {
+        const StagedEntry &entry = entries_[index_.slot(key.hash)];
+        return entry.hash == key.hash && entry.name() == key.name ? &entry : nullptr;
+    }
+    auto [first, last] = std::ranges::equal_range(entries_.first(heads_), key.hash, {}, &StagedEntry::hash);
+    for (; first != last; ++first) {
+        if (first->name() == key.name) return &*first;
+    }
+    return nullptr;
+}
+
+const StagedEntry *StagingSnapshot::match(JNIEnv *env, const StagingKey &key, jobject loader) const {
+    const StagedEntry *wildcard = nullptr;
+    for (const StagedEntry *entry = find(key); entry; entry = entry->next ? &entries_[entry->next] : nullptr) {
+        if (entry->flags & StagedEntry::anyLoader) {
+            if (!wildcard) wildcard = entry;
+        } else if (entry->loader ? loader && env->IsSameObject(entry->loader, loader) : !loader) {
+            return entry;
+        }
+    }
+    return wildcard;
+}
+
+std::size_t StagingSnapshot::indexBytes() const {
+    return entries_.size() * sizeof(StagedEntry) + (perfect_ ? index_.memoryBytes() : 0);
+}
+
+std::size_t StagingSnapshot::stagedBytes() const {
+    std::size_t total = 0;
+    for (const StagedEntry &entry: pending_.empty() ? std::span<const StagedEntry>(entries_) : pending_) {
+        total += entry.byteLength;
+    }
+    return total;
+}
+
+// Readers announce themselves in one of several padded slots, indexed by a
+// per-thread stripe, so concurrent class loads do not bounce a shared counter.
+// Each slot counts readers separately for the two epoch parities; a writer
+// flips the epoch twice and drains the old parity each time, which covers a
+// reader that sampled the epoch just before a flip (SRCU style).
+struct alignas(64) StagingReaderSlot {
+    std::atomic<std::uint64_t> active[2]{};
+};
+
+static constexpr std::size_t readerSlotCount = 64;
+static StagingReaderSlot readerSlots[readerSlotCount];
+static std::atomic<unsigned> readerEpoch{0};
+static std::mutex publishMutex;
+
+// Blocked Bloom filter over the staged names: every name sets three bits in a
+// single 64-bit word, so a probe is one load. Only publishStagingSnapshot()
+// writes these lines, and the empty flag lives on a line of its own.
+static constexpr std::size_t filterWordBits = 10;
+static constexpr std::size_t filterWordCount = std::size_t{1} << filterWordBits;
+
+struct StagingChannelState {
+    alignas(64) std::atomic<const StagingSnapshot *> current{nullptr};
+    alignas(64) std::atomic<bool> empty{true};
+    alignas(64) std::atomic<std::uint64_t> nameFilter[filterWordCount]{};
+};
+
+static StagingChannelState channels[stagingChannelCount];
+
+static StagingChannelState &channelState(const StagingChannel channel) {
+    return channels[static_cast<std::size_t>(channel)];
+}
+
+static std::size_t filterWord(const std::uint64_t h) {
+    return h >> (64 - filterWordBits);
+}
+
+static std::uint64_t filterMask(const std::uint64_t h) {
+    return std::uint64_t{1} << (h & 63) | std::uint64_t{1} << (h >> 6 & 63) | std::uint64_t{1} << (h >> 12 & 63);
+}
+
+bool stagingMayContain(const std::string_view name, StagingKey &key, const StagingChannel channel) {
+    const StagingChannelState &state = channelState(channel);
+    if (state.empty.load(std::memory_order_relaxed)) return false;
+    if (key.name.data() != name.data() || key.name.size() != name.size()) key = stagingKey(name);
+    const std::uint64_t mask = filterMask(key.hash);
+    return (state.nameFilter[filterWord(key.hash)].load(std::memory_order_relaxed) & mask) == mask;
+}
+
+static StagingReaderSlot *threadReaderSlot() {
+    static std::atomic<std::size_t> nextSlot{0};
+    thread_local StagingReaderSlot *slot =
+            &readerSlots[nextSlot.fetch_add(1, std::memory_order_relaxed) % readerSlotCount];
+    return slot;
+}
+
+StagingReadGuard::StagingReadGuard() : slot_(threadReaderSlot()) {
+    parity_ = readerEpoch.load() & 1;
+    slot_->active[parity_].fetch_add(1);
+}
+
+const StagingSnapshot *StagingReadGuard::snapshot(const StagingChannel channel) const {
+    return channelState(channel).current.load();
+}
+
+StagingReadGuard::~StagingReadGuard() {
+    slot_->active[parity_].fetch_sub(1, std::memory_order_release);
+}
+
+static void waitForReaders(const unsigned parity) {
+    for (auto &slot: readerSlots) {
+        while (slot.active[parity].load(std::memory_order_acquire) != 0) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void publishStagingSnapshot(std::unique_ptr<StagingSnapshot> next, const StagingChannel channel) {
+    if (next) next->seal();
+    std::vector<std::uint64_t> filter(filterWordCount);
+    const bool empty = !next || next->entries().empty();
+    if (!empty) {
+        for (const StagedEntry &entry: next->entries()) {
+            filter[filterWord(entry.hash)] |= filterMask(entry.hash);
+        }
+    }
+
+    StagingChannelState &state = channelState(channel);
+    std::lock_guard lock(publishMutex);
+    // Widen the filter before the new names become visible so a reader can
+    // never reject a class that is already in the published snapshot.
+    for (std::size_t i = 0; i < filterWordCount; ++i) {
+        if (filter[i]) state.nameFilter[i].fetch_or(filter[i], std::memory_order_relaxed);
+    }
+    if (!empty) state.empty.store(false);
+
+    const StagingSnapshot *old = state.current.exchange(next.release());
+    for (int round = 0; round < 2; ++round) {
+        waitForReaders(readerEpoch.fetch_add(1) & 1);
+    }
+    delete old;
+
+    // No reader can observe the old snapshot any more; drop its names.
+    for (std::size_t i = 0; i < filterWordCount; ++i) {
+        state.nameFilter[i].store(filter[i], std::memory_order_relaxed);
+    }
+    if (empty) state.empty.store(true);
+}
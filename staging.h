@@ -0,0 +1,196 @@
+#pragma once
+
+#include <jni.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "perfect_hash.h"
+
+// Independent published snapshots sharing one reader domain. Retransform
+// holds the batch being applied; Sticky holds class files re-applied on
+// every retransform of their class, whoever requests it; FirstLoad holds
+// class files waiting for their class to be loaded for the first time.
+enum class StagingChannel {
+    Retransform,
+    Sticky,
+    FirstLoad,
+};
+
+inline constexpr std::size_t stagingChannelCount = 3;
+
+// A name and its hash. The hook hashes a class name once and reuses the hash
+// for the filter probe and for the snapshot lookup.
+struct StagingKey {
+    std::string_view name;
+    std::uint64_t hash = 0;
+};
+
+StagingKey stagingKey(std::string_view name);
+
+// Hook activity for one staged class file, shared by every snapshot the
+// entry is published in so it carries over when the owner republishes.
+struct StagedEntryState {
+    explicit StagedEntryState(const bool singleUse = false) : singleUse(singleUse) {
+    }
+
+    // Consumed by the first hit; later hits in any snapshot are refused.
+    const bool singleUse;
+    std::atomic<bool> claimed{false};
+    std::atomic<std::uint64_t> hits{0};
+    // steady_clock time of the last hit, 0 if never hit.
+    std::atomic<std::int64_t> lastHitNanos{0};
+};
+
+// One staged class file. The hash is stored so a probe that lands on the
+// wrong entry rarely touches the name.
+//
+// Entries for the same name (one per loader) form a chain starting at the
+// entry the perfect hash points to, most recently staged first.
+struct alignas(16) StagedEntry {
+    // Matches a class of this name in any loader; exact loader matches win.
+    static constexpr std::uint32_t anyLoader = 1;
+
+    std::uint64_t hash;
+    const char *namePtr;
+    const unsigned char *bytesPtr;
+    // Canonical loader reference (see canonicalLoader()); nullptr for the
+    // bootstrap loader.
+    jweak loader;
+    std::uint32_t nameLength;
+    std::uint32_t byteLength;
+    // Index of the next entry with the same name, 0 at the end of the chain.
+    std::uint32_t next;
+    std::uint32_t flags;
+
+    std::string_view name() const { return {namePtr, nameLength}; }
+
+    std::span<const unsigned char> bytes() const { return {bytesPtr, byteLength}; }
+};
+
+// Immutable set of replacement class files seen by the ClassFileLoadHook.
+// A snapshot is never modified after it has been published; writers build a
+// new one and swap it in with publishStagingSnapshot().
+//
+// Keys and bytes copied in for the batch live in one monotonic arena that is
+// released in one go with the snapshot. Publishing seals the batch: entries
+// are placed in a flat array ordered by a minimal perfect hash, so a lookup
+// is one pilot load, one entry load and one name compare, followed by a walk
+// of that name's loaders. Loader references are borrowed and must outlive
+// the snapshot, as canonical ones do.
+//
+// Against the arena-backed unordered_map it replaced (bench/lookup_bench.cpp),
+// hits are 6-22 ns slower and the sealed table takes about 2% more memory.
+// It is kept for misses, which are most of what the hook sees and which it
+// rejects 25-100 ns sooner.
+struct StagingSnapshot {
+    explicit StagingSnapshot(std::size_t expectedBytes = 0);
+
+    void reserve(std::size_t classCount);
+
+    // Copies name into the arena and maps it, for classes defined by loader,
+    // to bytes, replacing any earlier entry with the same name and loader.
+    // With anyLoader set, loader is ignored and the entry matches classes
+    // of that name that no exact entry claims.
+    // A state, if given, is kept alive by the snapshot and updated by
+    // recordHit().
+    void stage(std::string_view name, std::span<const unsigned char> bytes, jweak loader = nullptr,
+               bool anyLoader = false, std::shared_ptr<StagedEntryState> state = nullptr);
+
+    // Like stage(), but keeps a view of name instead of copying it. The name
+    // must outlive the snapshot, as interned names do.
+    void stageInterned(std::string_view name, std::span<const unsigned char> bytes, jweak loader = nullptr,
+                       bool anyLoader = false, std::shared_ptr<StagedEntryState> state = nullptr);
+
+    // Arena storage for a class file that the caller fills in.
+    std::span<unsigned char> allocateBytes(std::size_t size);
+
+    // Builds the lookup index. Called by publishStagingSnapshot(); nothing
+    // may be staged afterwards.
+    void seal();
+
+    // Head of the name's chain, whatever its loader.
+    const StagedEntry *find(const StagingKey &key) const;
+
+    // Entry for the class named key.name being defined by loader (a local
+    // reference valid on env's thread, nullptr for the bootstrap loader).
+    const StagedEntry *match(JNIEnv *env, const StagingKey &key, jobject loader) const;
+
+    const StagedEntry *find(std::string_view name) const { return find(stagingKey(name)); }
+
+    // Counts a hook hit on entry. False if the entry is single-use and has
+    // already been consumed, in which case it must not be applied. Wait-free.
+    bool recordHit(const StagedEntry &entry) const;
+
+    std::span<const StagedEntry> entries() const { return entries_; }
+
+    bool empty() const { return entries_.empty() && pending_.empty(); }
+
+    // Bytes taken by the sealed entry array and the perfect hash.
+    std::size_t indexBytes() const;
+
+    // Total size of the class files staged, before or after sealing.
+    std::size_t stagedBytes() const;
+
+    std::pmr::monotonic_buffer_resource arena;
+    // Bytes shared with the staging set. Entries may also view caller-owned
+    // memory (direct buffers, raw addresses) that outlives the batch, in
+    // which case nothing is copied until the hook fires.
+    std::vector<std::shared_ptr<const std::vector<unsigned char> > > ownedBytes;
+
+private:
+    std::vector<StagedEntry> pending_;
+    std::vector<std::shared_ptr<StagedEntryState> > states_;
+    std::span<StagedEntry> entries_;
+    // Parallel to entries_; nullptr when no entry has a state.
+    StagedEntryState **entryStates_ = nullptr;
+    // Chain heads, one per distinct name, occupy the front of entries_.
+    std::size_t heads_ = 0;
+    PerfectHashIndex index_{&arena};
+    // False if PerfectHashIndex::build gave up, either because two names
+    // collided on their 64-bit hash or because some bucket found no free
+    // slots before its pilot search reached maxPilot; entries are then
+    // sorted by hash and searched instead.
+    bool perfect_ = false;
+};
+
+struct StagingReaderSlot;
+
+// Read-side critical section. Holding a guard keeps the snapshots it observes
+// alive; the constructor and destructor are wait-free.
+class StagingReadGuard {
+public:
+    StagingReadGuard();
+    ~StagingReadGuard();
+
+    StagingReadGuard(const StagingReadGuard &) = delete;
+    StagingReadGuard &operator=(const StagingReadGuard &) = delete;
+
+    const StagingSnapshot *snapshot(StagingChannel channel = StagingChannel::Retransform) const;
+
+private:
+    StagingReaderSlot *slot_;
+    unsigned parity_;
+};
+
+// Fast rejection for class loads that cannot match the published snapshot.
+// Reads one flag and one filter word and never enters a read-side critical
+// section; a false result is definitive, a true result must be confirmed
+// against the snapshot with the key filled in here. A key already computed
+// for name by an earlier call is reused. With nothing staged a miss is the
+// flag load alone, about 7 ns in miss_path_bench; once anything is staged it
+// also hashes the whole name, and costs 25-35 ns from 16 staged classes up.
+bool stagingMayContain(std::string_view name, StagingKey &key,
+                       StagingChannel channel = StagingChannel::Retransform);
+
+// Replaces the current snapshot and frees the previous one once every reader
+// that could still observe it has left its critical section. Writers are
+// serialized against each other; readers are never blocked.
+void publishStagingSnapshot(std::unique_ptr<StagingSnapshot> next,
+                            StagingChannel channel = StagingChannel::Retransform);
@@ -0,0 +1,120 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "error_names.h"
+#include "event_format.h"
+
+// Turns a ring file written by the event recorder into CSV or JSON, oldest
+// event first. Safe to run on a file that is still being recorded into:
+// records caught mid-write are skipped.
+
+static const char *typeName(const EventType type) {
+    switch (type) {
+        case EventType::HookHit: return "hook_hit";
+        case EventType::Redefine: return "redefine";
+        case EventType::Retransform: return "retransform";
+        case EventType::CapabilityChange: return "capability_change";
+        case EventType::StagingCommit: return "staging_commit";
+    }
+    return "unknown";
+}
+
+static std::string csvField(const std::string_view text) {
+    if (text.find_first_of(",\"\n") == std::string_view::npos) return std::string(text);
+    std::string quoted = "\"";
+    for (const char c: text) {
+        if (c == '"') quoted += '"';
+        quoted += c;
+    }
+    return quoted + '"';
+}
+
+static std::string jsonString(const std::string_view text) {
+    std::string quoted = "\"";
+    char escape[8];
+    for (const unsigned char c: text) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += static_cast<char>(c);
+        } else if (c < 0x20) {
+            snprintf(escape, sizeof(escape), "\\u%04x", c);
+            quoted += escape;
+        } else {
+            quoted += static_cast<char>(c);
+        }
+    }
+    return quoted + '"';
+}
+
+int main(const int argc, char **argv) {
+    if (argc < 2 || argc > 3 || (argc == 3 && strcmp(argv[2], "--csv") != 0 && strcmp(argv[2], "--json") != 0)) {
+        fprintf(stderr, "usage: %s <event file> [--csv|--json]\n", argv[0]);
+        return 2;
+    }
+    const bool json = argc == 3 && strcmp(argv[2], "--json") == 0;
+
+    std::ifstream in(argv[1], std::ios::binary | std::ios::ate);
+    if (!in) {
+        fprintf(stderr, "cannot open %s\n", argv[1]);
+        return 1;
+    }
+    const auto size = static_cast<std::size_t>(in.tellg());
+    // Read into records so the header and records keep their alignment.
+    std::vector<EventRecord> storage((size + sizeof(EventRecord) - 1) / sizeof(EventRecord) + 1);
+    in.seekg(0);
+    in.read(reinterpret_cast<char *>(storage.data()), static_cast<std::streamsize>(size));
+
+    const auto *header = reinterpret_cast<const EventFileHeader *>(storage.data());
+    if (size < sizeof(EventFileHeader) || memcmp(header->magic, eventFileMagic, sizeof(eventFileMagic)) != 0 ||
+        header->version != eventFileVersion || header->recordSize != sizeof(EventRecord)) {
+        fprintf(stderr, "%s is not an event file of version %u\n", argv[1], eventFileVersion);
+        return 1;
+    }
+    const std::uint64_t capacity = std::min<std::uint64_t>(
+        header->capacity, (size - sizeof(EventFileHeader)) / sizeof(EventRecord));
+    const auto *records = reinterpret_cast<const EventRecord *>(header + 1);
+
+    // A writer lapped by faster ones can publish its record late, over a
+    // newer one; only the last capacity positions handed out are current.
+    const std::uint64_t next = header->next.load(std::memory_order_relaxed);
+    const std::uint64_t oldest = next > capacity ? next - capacity : 0;
+    std::vector<const EventRecord *> events;
+    for (std::uint64_t i = 0; i < capacity; ++i) {
+        const std::uint64_t sequence = records[i].sequence.load(std::memory_order_relaxed);
+        if (sequence > oldest && (sequence - 1) % capacity == i) events.push_back(&records[i]);
+    }
+    std::ranges::sort(events, {}, [](const EventRecord *record) {
+        return record->sequence.load(std::memory_order_relaxed);
+    });
+
+    if (!json) printf("sequence,time_ns,type,thread,duration_ns,count,bytes,flags,error,error_name,text\n");
+    else printf("[");
+    for (std::size_t e = 0; e < events.size(); ++e) {
+        const EventRecord &record = *events[e];
+        const std::string_view text(record.text, strnlen(record.text, EventRecord::textCapacity));
+        const char *errorName = getErrorName(static_cast<jvmtiError>(record.error));
+        if (json) {
+            printf("%s\n  {\"sequence\":%llu,\"time_ns\":%lld,\"type\":\"%s\",\"thread\":%u,\"duration_ns\":%lld,"
+                   "\"count\":%u,\"bytes\":%llu,\"flags\":%u,\"error\":%d,\"error_name\":\"%s\",\"text\":%s}",
+                   e ? "," : "", static_cast<unsigned long long>(record.sequence.load(std::memory_order_relaxed)),
+                   static_cast<long long>(record.timeNanos), typeName(record.type), record.thread,
+                   static_cast<long long>(record.durationNanos), record.count,
+                   static_cast<unsigned long long>(record.bytes), record.flags, record.error, errorName,
+                   jsonString(text).c_str());
+        } else {
+            printf("%llu,%lld,%s,%u,%lld,%u,%llu,%u,%d,%s,%s\n",
+                   static_cast<unsigned long long>(record.sequence.load(std::memory_order_relaxed)),
+                   static_cast<long long>(record.timeNanos), typeName(record.type), record.thread,
+                   static_cast<long long>(record.durationNanos), record.count,
+                   static_cast<unsigned long long>(record.bytes), record.flags, record.error, errorName,
+                   csvField(text).c_str());
+        }
+    }
+    if (json) printf("%s]\n", events.empty() ? "" : "\n");
+    return 0;
+}